@@ -0,0 +1,367 @@
+//builds synthetic folder trees and runs the display-free core over them the
+//way the explorer does: listing one folder, walking the whole tree, sorting,
+//classifying, formatting the columns and laying out the rows, and streams the
+//tree as --tree does, to /dev/null. prints one JSON
+//object per shape and phase, so runs can be appended to a file and compared.
+//usage: bin/core_bench [--shape wide|deep|tiny|all] [--entries N] [--dir D] [--keep]
+//  wide: one folder holding all the entries
+//  deep: a chain of DEEP_LEVELS folders, the entries spread over them
+//  tiny: TINY_FANOUT^3 small folders of short files with a few bytes each
+//(default: all shapes, 100000 entries each, under $TMPDIR, removed afterwards)
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "entrystore.h"
+#include "filetypes.h"
+#include "treewalker.h"
+#include "listview.h"
+#include "lister.h"
+
+#define DEEP_LEVELS 64
+#define TINY_FANOUT 8
+#define WALK_DEPTH 1000 //deep enough for every shape
+
+//heap use of the whole process, walker threads included
+static std::atomic<size_t> alloc_count(0);
+static std::atomic<size_t> alloc_bytes(0);
+
+void *operator new(size_t n){
+    void *p = malloc(n);
+    if(p == NULL){
+        throw std::bad_alloc();
+    }
+    alloc_count++;
+    alloc_bytes += n;
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+static const char *WORDS[] = { "report", "draft", "IMG_", "backup", "Notes", "invoice", "data", "final",
+                               "photo", "Scan", "video", "archive", "test", "build", "log", "readme" };
+static const char *EXTENSIONS[] = { ".txt", ".JPG", ".pdf", ".tar.gz", ".cpp", ".h", ".mp4", "",
+                                    ".png", ".py", ".json", ".o", ".cpp.bak", ".md", ".csv", ".html" };
+
+//resets the kernel's resident set high-water mark so VmHWM covers only what
+//follows. false on kernels without /proc/self/clear_refs
+static bool resetPeakRss(){
+    int fd = open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+    if(fd < 0){
+        return false;
+    }
+    bool reset = write(fd, "5", 1) == 1;
+    close(fd);
+    return reset;
+}
+
+//VmHWM of this process in kB, -1 if it can not be read
+static long peakRss(){
+    FILE *status = fopen("/proc/self/status", "re");
+    if(status == NULL){
+        return -1;
+    }
+    char line[256];
+    long kb = -1;
+    while(fgets(line, sizeof(line), status) != NULL){
+        if(sscanf(line, "VmHWM: %ld kB", &kb) == 1){
+            break;
+        }
+    }
+    fclose(status);
+    return kb;
+}
+
+//one phase of one shape, measured from construction to report().
+//peak_rss_kb is the highest resident set seen during the phase (what was
+//already resident when it started included), or -1 where the peak can not be
+//reset; process_peak_rss_kb is the peak of the whole run so far
+class Phase {
+    public:
+        Phase(const std::string &shape, const char *name) : shape(shape), name(name){
+            peak_reset = resetPeakRss();
+            allocs = alloc_count;
+            bytes = alloc_bytes;
+            start = std::chrono::steady_clock::now();
+        }
+        void report(size_t entries, size_t folders){
+            std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - start;
+            double ms = took.count();
+            long peak = peakRss();
+            if(peak > process_peak){
+                process_peak = peak; //the reset lowers ru_maxrss too, so keep the run's peak here
+            }
+            printf("{\"bench\":\"core\",\"shape\":\"%s\",\"phase\":\"%s\",\"entries\":%zu,\"folders\":%zu,"
+                   "\"ms\":%.3f,\"entries_per_s\":%.0f,\"allocs\":%zu,\"alloc_bytes\":%zu,\"peak_rss_kb\":%ld,"
+                   "\"process_peak_rss_kb\":%ld}\n",
+                   shape.c_str(), name, entries, folders, ms, ms > 0 ? entries / ms * 1000 : 0.0,
+                   alloc_count - allocs, alloc_bytes - bytes, peak_reset ? peak : -1, process_peak);
+            fflush(stdout);
+        }
+
+    private:
+        std::string shape;
+        const char *name;
+        bool peak_reset;
+        size_t allocs;
+        size_t bytes;
+        std::chrono::steady_clock::time_point start;
+        static long process_peak;
+};
+
+long Phase::process_peak = -1;
+
+static unsigned seed = 1;
+static volatile size_t sink; //keeps the measured loops from being optimized out
+
+static std::string entryName(size_t i){
+    seed = seed * 1103515245 + 12345;
+    char name[64];
+    snprintf(name, sizeof(name), "%s%zu%s", WORDS[(seed >> 8) % 16], i, EXTENSIONS[(seed >> 16) % 16]);
+    return name;
+}
+
+//count files in dir, with a few bytes in each if tiny. false if one could not be made
+static bool makeFiles(const std::string &dir, size_t first, size_t count, bool tiny){
+    for(size_t i = first; i < first + count; i++){
+        std::string path = dir + "/" + entryName(i);
+        int fd = open(path.c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, (seed >> 24) % 8 == 0 ? 0755 : 0644);
+        if(fd < 0){
+            perror(path.c_str());
+            return false;
+        }
+        if(tiny){
+            char bytes[64];
+            memset(bytes, 'x', sizeof(bytes));
+            if(write(fd, bytes, 1 + (seed >> 4) % sizeof(bytes)) < 0){
+                perror(path.c_str());
+            }
+        }
+        close(fd);
+    }
+    return true;
+}
+
+static bool makeTiny(const std::string &dir, int level, size_t per_folder, size_t *next){
+    if(!makeFiles(dir, *next, per_folder, true)){
+        return false;
+    }
+    *next += per_folder;
+    for(int i = 0; i < TINY_FANOUT && level < 3; i++){
+        std::string sub = dir + "/dir" + std::to_string(i);
+        if(mkdir(sub.c_str(), 0755) != 0 || !makeTiny(sub, level + 1, per_folder, next)){
+            return false;
+        }
+    }
+    return true;
+}
+
+//the tree of shape under root, about entries entries in all
+static bool makeTree(const std::string &root, const std::string &shape, size_t entries){
+    if(mkdir(root.c_str(), 0755) != 0){
+        perror(root.c_str());
+        return false;
+    }
+    if(shape == "wide"){
+        return makeFiles(root, 0, entries, false);
+    }
+    if(shape == "deep"){
+        std::string dir = root;
+        size_t per_level = entries / DEEP_LEVELS;
+        for(int level = 0; level < DEEP_LEVELS; level++){
+            if(!makeFiles(dir, level * per_level, per_level, false)){
+                return false;
+            }
+            dir += "/level" + std::to_string(level);
+            if(mkdir(dir.c_str(), 0755) != 0){
+                return false;
+            }
+        }
+        return true;
+    }
+    size_t folders = 1 + TINY_FANOUT + TINY_FANOUT * TINY_FANOUT + TINY_FANOUT * TINY_FANOUT * TINY_FANOUT;
+    size_t next = 0;
+    return makeTiny(root, 0, entries / folders, &next);
+}
+
+static int removeEntry(const char *path, const struct stat *st, int flag, struct FTW *ftw){
+    return remove(path);
+}
+
+static void runShape(const std::string &root, const std::string &shape, size_t entries, bool keep){
+    Phase generate(shape, "generate");
+    if(!makeTree(root, shape, entries)){
+        fprintf(stderr, "could not build the %s tree in %s\n", shape.c_str(), root.c_str());
+        exit(1);
+    }
+    generate.report(entries, 0);
+
+    //one folder, as when it is opened
+    {
+        EntryStore list;
+        Phase phase(shape, "list");
+        updateFileList(&list, root, false, SortOrder());
+        phase.report(list.size(), 1);
+    }
+
+    //the recursive view
+    std::vector<TreeNode> nodes;
+    size_t total = 0;
+    {
+        TreeWalker walker([]{});
+        std::vector<TreeWalker::Result> results;
+        Phase phase(shape, "walk");
+        unsigned gen = walker.start(root, WALK_DEPTH, SortOrder());
+        while(true){
+            bool done = walker.progress().done;
+            walker.poll(&results);
+            for(int i = 0; i < results.size(); i++){
+                if(results[i].generation == gen){
+                    if(results[i].index >= nodes.size()){
+                        nodes.resize(results[i].index + 1);
+                    }
+                    int parent_entry = nodes[results[i].index].parent_entry;
+                    nodes[results[i].index] = std::move(*results[i].node);
+                    nodes[results[i].index].parent_entry = parent_entry;
+                    linkChildren(&nodes, results[i].index);
+                }
+                delete results[i].node;
+            }
+            if(done){
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        for(int n = 0; n < nodes.size(); n++){
+            total += nodes[n].entries.size();
+        }
+        phase.report(total, nodes.size());
+    }
+
+    //the headless listing, walk and output together
+    {
+        int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        ListTotals totals;
+        Phase phase(shape, "stream");
+        streamListing(root, WALK_DEPTH, LIST_NDJSON, null_fd, &totals);
+        phase.report(totals.entries, totals.folders);
+        close(null_fd);
+    }
+
+    //by size, then back to name order, every folder
+    {
+        SortOrder by_size;
+        by_size.key = SORT_SIZE;
+        Phase phase(shape, "sort");
+        for(int n = 0; n < nodes.size(); n++){
+            nodes[n].entries.sort(by_size);
+            nodes[n].entries.sort(SortOrder());
+        }
+        phase.report(2 * total, nodes.size());
+    }
+
+    {
+        size_t images = 0;
+        Phase phase(shape, "classify");
+        for(int n = 0; n < nodes.size(); n++){
+            const EntryStore &list = nodes[n].entries;
+            for(size_t i = 0; i < list.size(); i++){
+                images += classifyFile(list.name(i), list.nameLength(i), list.mode(i)) == TYPE_IMAGE;
+            }
+        }
+        phase.report(total, nodes.size());
+        sink = images;
+    }
+
+    //the size and permission columns of every row
+    {
+        size_t chars = 0;
+        Phase phase(shape, "format");
+        for(int n = 0; n < nodes.size(); n++){
+            const EntryStore &list = nodes[n].entries;
+            for(size_t i = 0; i < list.size(); i++){
+                double size;
+                SizeUnit units;
+                char perms[PERMS_TEXT_SIZE];
+                fitFilesizeToUnit(list.fileSize(i), &size, &units);
+                setFilePermField(perms, list.mode(i));
+                chars += strlen(perms) + (size_t)size % 10;
+            }
+        }
+        phase.report(total, nodes.size());
+        sink = chars;
+    }
+
+    //every folder open, then every row looked up once as when scrolling through
+    {
+        Phase phase(shape, "layout");
+        layoutTree(&nodes);
+        int rows = rowCount(nodes);
+        size_t depth_sum = 0;
+        for(int r = 0; r < rows; r++){
+            depth_sum += findRow(nodes, r).depth;
+        }
+        phase.report(rows, nodes.size());
+        sink = depth_sum;
+    }
+
+    if(!keep){
+        nftw(root.c_str(), removeEntry, 64, FTW_DEPTH | FTW_PHYS);
+    }
+}
+
+int main(int argc, char **argv){
+    std::string only = "all";
+    size_t entries = 100000;
+    std::string dir;
+    bool keep = false;
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--shape") == 0 && i + 1 < argc){
+            only = argv[++i];
+        } else if(strcmp(argv[i], "--entries") == 0 && i + 1 < argc){
+            entries = atol(argv[++i]);
+        } else if(strcmp(argv[i], "--dir") == 0 && i + 1 < argc){
+            dir = argv[++i];
+        } else if(strcmp(argv[i], "--keep") == 0){
+            keep = true;
+        } else {
+            fprintf(stderr, "usage: %s [--shape wide|deep|tiny|all] [--entries N] [--dir D] [--keep]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(dir.empty()){
+        const char *tmp = getenv("TMPDIR");
+        std::string pattern = std::string(tmp != NULL ? tmp : "/tmp") + "/core_bench.XXXXXX";
+        std::vector<char> name(pattern.begin(), pattern.end());
+        name.push_back('\0');
+        if(mkdtemp(name.data()) == NULL){
+            perror(pattern.c_str());
+            return 1;
+        }
+        dir = name.data();
+    }
+
+    static const char *shapes[] = { "wide", "deep", "tiny" };
+    for(int s = 0; s < 3; s++){
+        if(only == "all" || only == shapes[s]){
+            runShape(dir + "/" + shapes[s], shapes[s], entries, keep);
+        }
+    }
+    if(!keep){
+        rmdir(dir.c_str()); //only if it was empty, never someone's --dir with things in it
+    }
+    return 0;
+}
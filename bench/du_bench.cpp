@@ -0,0 +1,113 @@
+//sizes a folder tree with FolderSizer and checks it against a plain serial
+//du: same total and file count, exits 1 if they differ. subfolder totals are
+//compared too, but only reported: a file hard linked from two subfolders is
+//counted in whichever one gets to it first, on the pool that varies.
+//usage: bin/du_bench [root] [threads]   (default: . one thread per core, at least 4)
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "scanner.h"
+#include "foldersizer.h"
+
+typedef std::map<std::string, std::pair<uint64_t, uint64_t> > Totals; //folder -> bytes, files
+
+static void serialDu(const std::string &path, dev_t dev, uint64_t own, std::set<std::pair<dev_t, ino_t> > *links,
+                     Totals *totals, uint64_t *bytes_out, uint64_t *files_out){
+    uint64_t bytes = own;
+    uint64_t files = 0;
+    int dirfd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if(dirfd >= 0){
+        std::vector<std::pair<std::string, uint64_t> > subfolders;
+        listNames(dirfd, [&](const char *name, unsigned char d_type){
+            struct stat st;
+            if(fstatat(dirfd, name, &st, AT_SYMLINK_NOFOLLOW) != 0){
+                return;
+            }
+            if(S_ISDIR(st.st_mode)){
+                if(st.st_dev == dev){
+                    subfolders.push_back(std::make_pair(std::string(name), (uint64_t)st.st_blocks * 512));
+                }
+            } else if(st.st_nlink < 2 || links->insert(std::make_pair(st.st_dev, st.st_ino)).second){
+                bytes += st.st_blocks * 512;
+                files++;
+            }
+        });
+        close(dirfd);
+        for(int i = 0; i < subfolders.size(); i++){
+            uint64_t sub_bytes, sub_files;
+            serialDu((path == "/" ? "" : path) + "/" + subfolders[i].first, dev, subfolders[i].second,
+                     links, totals, &sub_bytes, &sub_files);
+            bytes += sub_bytes;
+            files += sub_files;
+        }
+    }
+    (*totals)[path] = std::make_pair(bytes, files);
+    *bytes_out = bytes;
+    *files_out = files;
+}
+
+static double seconds(std::chrono::steady_clock::time_point start){
+    std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+    return took.count();
+}
+
+int main(int argc, char **argv){
+    std::string root = argc > 1 ? argv[1] : ".";
+    unsigned threads = argc > 2 ? atoi(argv[2]) : 0;
+
+    struct stat st;
+    if(lstat(root.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)){
+        std::cerr << root << " is not a folder\n";
+        return 1;
+    }
+    Totals serial;
+    std::set<std::pair<dev_t, ino_t> > links;
+    uint64_t bytes, files;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    serialDu(root, st.st_dev, st.st_blocks * 512, &links, &serial, &bytes, &files);
+    double serial_time = seconds(start);
+
+    FolderSizer sizer([]{}, threads);
+    FolderSize total;
+    start = std::chrono::steady_clock::now();
+    sizer.measure(root);
+    while(!sizer.size(root, &total) || !total.done){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    double sizer_time = seconds(start);
+
+    int differing = 0;
+    std::string first_difference;
+    for(Totals::iterator it = serial.begin(); it != serial.end(); ++it){
+        FolderSize sub;
+        if(!sizer.size(it->first, &sub) || !sub.done || sub.bytes != it->second.first || sub.files != it->second.second){
+            if(differing++ == 0){
+                first_difference = it->first;
+            }
+        }
+    }
+
+    bool same = total.bytes == bytes && total.files == files;
+    std::cout << "folders\tfiles\tbytes\tserial(s)\tsizer(s)\tthreads\tidentical\n";
+    std::cout << serial.size() << "\t" << files << "\t" << bytes << "\t" << serial_time << "\t" << sizer_time << "\t"
+              << (threads ? threads : std::max(4u, std::thread::hardware_concurrency())) << "\t"
+              << (same ? "yes" : "NO") << "\n";
+    if(!same){
+        std::cout << "sizer total " << total.bytes << " bytes, " << total.files << " files\n";
+    }
+    if(differing > 0){
+        std::cout << differing << " subfolder totals differ (hard links?), first " << first_difference << "\n";
+    }
+    if(!same){
+        return 1;
+    }
+    return 0;
+}
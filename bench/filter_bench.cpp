@@ -0,0 +1,82 @@
+//types a query into the filter one character at a time over a folder of
+//generated names, then pastes a variant of it, and times each step the way
+//the UI pays for it:
+//matching plus relaying out the rows. every result is checked against a
+//plain case-insensitive search, exits 1 if one differs.
+//usage: bin/filter_bench [entries] [query]   (default: 1000000 "report_2")
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdlib.h>
+#include <strings.h>
+#include <string.h>
+#include "entrystore.h"
+#include "listview.h"
+
+static const char *WORDS[] = { "report", "draft", "IMG", "backup", "notes", "Invoice", "data", "final",
+                               "photo", "scan", "video", "archive", "test", "build", "log", "readme" };
+static const char *EXTENSIONS[] = { ".txt", ".JPG", ".pdf", ".tar.gz", ".cpp", ".h", ".mp4", "" };
+
+static double millis(std::chrono::steady_clock::time_point start){
+    std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - start;
+    return took.count();
+}
+
+int main(int argc, char **argv){
+    size_t count = argc > 1 ? atol(argv[1]) : 1000000;
+    std::string query = argc > 2 ? argv[2] : "report_2";
+
+    std::vector<TreeNode> nodes(1);
+    nodes[0].loaded = true;
+    EntryStore &store = nodes[0].entries;
+    srand(1);
+    char name[128];
+    for(size_t i = 0; i < count; i++){
+        int len = snprintf(name, sizeof(name), "%s_%s_%u%s", WORDS[rand() % 16], WORDS[rand() % 16],
+                           (unsigned)rand() % 100000, EXTENSIONS[rand() % 8]);
+        store.add(name, len, TYPE_OTHER, 0644, i, 0, false);
+    }
+    store.sort(SortOrder());
+    layoutNode(&nodes, 0);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    prepareFilter(&nodes, 0);
+    double prepare_ms = millis(start);
+
+    std::cout << "entries\tquery\tmatches\trows\tms\tidentical\n";
+    bool all_same = true;
+    double worst = 0;
+    //typed one character at a time, then the query without its first
+    //character as if pasted, which cannot build on the previous result
+    std::vector<std::string> steps;
+    for(size_t typed = 1; typed <= query.size(); typed++){
+        steps.push_back(query.substr(0, typed));
+    }
+    if(query.size() > 3){
+        steps.push_back(query.substr(1));
+    }
+    for(size_t step = 0; step < steps.size(); step++){
+        const std::string &text = steps[step];
+        start = std::chrono::steady_clock::now();
+        filterNode(&nodes, 0, text);
+        layoutTree(&nodes);
+        double took = millis(start);
+        worst = std::max(worst, took);
+
+        size_t matches = 0;
+        bool same = true;
+        for(size_t i = 0; i < store.size(); i++){
+            bool expect = strcasestr(store.name(i), text.c_str()) != NULL;
+            same = same && (expect == (nodes[0].shown[i] != 0));
+            matches += expect;
+        }
+        same = same && rowCount(nodes) == (int)matches;
+        all_same = all_same && same;
+        std::cout << count << "\t" << text << "\t" << matches << "\t" << rowCount(nodes) << "\t" << took << "\t"
+                  << (same ? "yes" : "NO") << "\n";
+    }
+    std::cout << "index built in " << prepare_ms << " ms (" << nodes[0].index.memoryUsage() / (1 << 20)
+              << " MB), slowest keystroke " << worst << " ms\n";
+    return all_same ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+//time to start a child with fork()+exec, as the explorer used to, against
+//Launcher (posix_spawn) while the process holds more and more memory, and
+//checks that the reaper collects every child. the opener is /bin/true.
+//exits 1 if a child could not be started or was not reaped.
+//usage: bin/launch_bench [MB...]   (default: 0 256 1024)
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "launcher.h"
+
+#define LAUNCHES 20
+
+static double micros(std::chrono::steady_clock::time_point start){
+    std::chrono::duration<double, std::micro> took = std::chrono::steady_clock::now() - start;
+    return took.count();
+}
+
+int main(int argc, char **argv){
+    std::vector<size_t> sizes;
+    for(int i = 1; i < argc; i++){
+        sizes.push_back(atol(argv[i]));
+    }
+    if(sizes.empty()){
+        sizes.push_back(0);
+        sizes.push_back(256);
+        sizes.push_back(1024);
+    }
+
+    bool ok = true;
+    //one Launcher at a time, it owns SIGCHLD
+    {
+        std::vector<std::string> missing(1, "file");
+        std::string error;
+        Launcher broken([](){}, "/nonexistent/opener");
+        if(broken.open(missing, &error) || broken.running() != 0){
+            std::cout << "a missing opener was not reported\n";
+            ok = false;
+        }
+    }
+
+    std::mutex lock;
+    std::condition_variable woken;
+    int wakes = 0;
+    Launcher launcher([&](){
+        std::lock_guard<std::mutex> guard(lock);
+        wakes++;
+        woken.notify_one();
+    }, "/bin/true");
+
+    std::cout << "resident(MB)\tfork(us)\tspawn(us)\tspawn worst(us)\treaped\n";
+    std::vector<char> ballast;
+    for(int s = 0; s < sizes.size(); s++){
+        ballast.assign(sizes[s] << 20, 1); //every page touched, so fork has to copy the page tables
+
+        double fork_us = 0;
+        for(int i = 0; i < LAUNCHES; i++){
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            pid_t pid = fork();
+            if(pid == 0){
+                execl("/bin/true", "/bin/true", (char *)NULL);
+                _exit(127);
+            }
+            fork_us += micros(start);
+            int status;
+            waitpid(pid, &status, 0);
+        }
+
+        std::vector<std::string> paths(LAUNCHES, "file");
+        std::string error;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if(!launcher.open(paths, &error)){
+            std::cout << error << "\n";
+            ok = false;
+        }
+        double spawn_us = micros(start);
+
+        //what the event loop does: reap whenever woken, until all are in
+        size_t reaped = 0;
+        std::vector<LaunchResult> ended;
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while(launcher.running() > 0 && std::chrono::steady_clock::now() < deadline){
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                woken.wait_for(guard, std::chrono::milliseconds(100), [&](){ return wakes > 0; });
+                wakes = 0;
+            }
+            launcher.reap(&ended);
+            for(int i = 0; i < ended.size(); i++){
+                ok = ok && ended[i].status == 0;
+            }
+            reaped += ended.size();
+        }
+        ok = ok && reaped == LAUNCHES;
+        std::cout << sizes[s] << "\t" << fork_us / LAUNCHES << "\t" << spawn_us / LAUNCHES << "\t"
+                  << launcher.worstLaunchUs() << "\t" << reaped << "/" << LAUNCHES << "\n";
+    }
+
+    return ok ? 0 : 1;
+}
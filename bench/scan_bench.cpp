@@ -0,0 +1,163 @@
+//compares the old opendir/readdir/stat loop from updateFileList against
+//scanDirectory (with each stat backend) on flat synthetic directories.
+//usage: bin/scan_bench [--delay us] [root] [entries...]   (default: /tmp/fileexplorer_bench 10000 100000 1000000)
+//point root at an nfs/sshfs/fuse mount to see the effect of keeping requests in flight,
+//or pass --delay to make every stat that much slower on any filesystem (the readdir
+//loop is not slowed, use small counts: sync at 1000us is a second per 1000 entries).
+//for cold-cache numbers run as root with "echo 3 > /proc/sys/vm/drop_caches" between runs.
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "scanner.h"
+#include "asyncstat.h"
+
+//makes root/flat_<count> holding count files (every 10th one a folder), reused
+//between runs. exits if any of it can not be made, rather than timing a short tree
+static std::string makeTree(const std::string &root, long count){
+    std::string dir = root + "/flat_" + std::to_string(count);
+    if(mkdir(root.c_str(), 0755) != 0 && errno != EEXIST){
+        perror(root.c_str());
+        exit(1);
+    }
+    if(mkdir(dir.c_str(), 0755) != 0){
+        if(errno == EEXIST){
+            return dir; //already generated
+        }
+        perror(dir.c_str());
+        exit(1);
+    }
+    std::cout << "generating " << dir << "...\n";
+    for(long i = 0; i < count; i++){
+        std::string path = dir + "/entry_" + std::to_string(i);
+        if(i % 10 == 0){
+            if(mkdir(path.c_str(), 0755) != 0){
+                perror(path.c_str());
+                exit(1);
+            }
+        } else {
+            int fd = open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+            if(fd < 0){
+                perror(path.c_str());
+                exit(1);
+            }
+            close(fd);
+        }
+    }
+    return dir;
+}
+
+//the loop updateFileList used before scanDirectory
+static long readdirScan(const std::string &filepath){
+    DIR *dir;
+    struct dirent *entry;
+    long seen = 0;
+    if((dir = opendir(filepath.c_str())) != NULL){
+        while((entry = readdir(dir)) != NULL){
+            if(entry->d_type == DT_REG){
+                struct stat filestats;
+                std::string fpath = (filepath + "/" + entry->d_name);
+                stat(fpath.c_str(), &filestats);
+                seen++;
+            } else if(entry->d_type == DT_DIR){
+                std::string name = entry->d_name;
+                if(name != "."){
+                    seen++;
+                }
+            }
+        }
+        closedir(dir);
+    }
+    return seen;
+}
+
+static long batchedScan(const std::string &filepath){
+    std::vector<ScanEntry> entries;
+    scanDirectory(filepath, &entries);
+    return entries.size();
+}
+
+static double bestOf(int runs, long (*scan)(const std::string &), const std::string &dir, long *seen){
+    double best = -1;
+    for(int i = 0; i < runs; i++){
+        auto start = std::chrono::steady_clock::now();
+        *seen = scan(dir);
+        std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+        if(best < 0 || took.count() < best){
+            best = took.count();
+        }
+    }
+    return best;
+}
+
+int main(int argc, char **argv){
+    std::string root = "/tmp/fileexplorer_bench";
+    std::vector<long> counts;
+    unsigned delay = 0;
+    int arg = 1;
+    if(arg + 1 < argc && std::string(argv[arg]) == "--delay"){
+        delay = atol(argv[arg + 1]);
+        arg += 2;
+    }
+    if(arg < argc){
+        root = argv[arg++];
+    }
+    for(; arg < argc; arg++){
+        counts.push_back(atol(argv[arg]));
+    }
+    if(counts.empty()){
+        counts.push_back(10000);
+        counts.push_back(100000);
+        counts.push_back(1000000);
+    }
+
+    std::vector<std::string> dirs;
+    for(int i = 0; i < counts.size(); i++){
+        dirs.push_back(makeTree(root, counts[i]));
+    }
+
+    StatBackend backends[] = {STAT_SYNC, STAT_THREADS, STAT_URING};
+    const char *names[] = {"sync", "threads", "io_uring"};
+    int nbackends = 2;
+#ifdef USE_IO_URING
+    nbackends = 3;
+#endif
+
+    if(delay > 0){
+        std::cout << "every stat delayed by " << delay << "us\n";
+    }
+    std::cout << "entries\treaddir+stat(s)";
+    for(int b = 0; b < nbackends; b++){
+        std::cout << "\t" << names[b] << "(s)";
+    }
+    std::cout << '\n';
+    for(int i = 0; i < dirs.size(); i++){
+        std::string dir = dirs[i];
+        long seen_old, seen_new;
+        double t_old = bestOf(3, readdirScan, dir, &seen_old);
+        std::cout << seen_old << '\t' << t_old;
+        setStatDelay(delay);
+        for(int b = 0; b < nbackends; b++){
+            setStatBackend(backends[b]);
+            double t_new = bestOf(3, batchedScan, dir, &seen_new);
+            if(statBackend() != backends[b]){
+                std::cout << "\tunavailable";
+                continue;
+            }
+            std::cout << '\t' << t_new;
+            if(seen_old != seen_new){
+                std::cout << " (saw " << seen_new << ")";
+            }
+        }
+        setStatDelay(0);
+        std::cout << '\n';
+    }
+    return 0;
+}
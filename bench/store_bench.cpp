@@ -0,0 +1,144 @@
+//memory per entry and sort time of the old FileData vector against EntryStore,
+//plus how long re-sorting an already loaded store by another key takes.
+//usage: bin/store_bench [entries...]   (default: 10000 100000 1000000)
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <sys/stat.h>
+#include "entrystore.h"
+
+//every heap byte the program holds, so both layouts are measured the same way
+static size_t live_bytes = 0;
+
+void *operator new(size_t n){
+    void *p = malloc(n);
+    if(p == NULL){
+        throw std::bad_alloc();
+    }
+    live_bytes += malloc_usable_size(p);
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    if(p != NULL){
+        live_bytes -= malloc_usable_size(p);
+        free(p);
+    }
+}
+
+//FileData as it was before the columnar store, SDL types swapped for same-sized stand-ins
+struct LegacyRect { int x, y, w, h; };
+class LegacyFileData {
+    public:
+        void *text_texture;
+        void *icon_texture;
+        void *size_texture;
+        void *permissions_texture;
+        LegacyRect text_rect;
+        LegacyRect icon_rect;
+        LegacyRect size_rect;
+        LegacyRect permissions_rect;
+
+        std::string filename;
+        std::string type;
+        std::string path;
+        double size;
+        std::string perms;
+        std::string units;
+        int child_index;
+};
+
+static bool legacyCompare(const LegacyFileData &a, const LegacyFileData &b){
+    std::string _a = a.filename;
+    std::string _b = b.filename;
+    transform(_a.begin(), _a.end(), _a.begin(), ::tolower);
+    transform(_b.begin(), _b.end(), _b.begin(), ::tolower);
+    return _a < _b;
+}
+
+//names shaped like a real home folder: mixed case, varied length, shuffled
+static std::string syntheticName(long i){
+    static const char *stems[] = {"report", "IMG_", "Makefile", "notes", "build-output", "a", "Screenshot from 2021-05-17 ", "data"};
+    static const char *exts[] = {".txt", ".png", "", ".cpp", ".tar.gz", ".md"};
+    long h = (i * 2654435761u) % 1000003;
+    return std::string(stems[h % 8]) + std::to_string(h) + exts[h % 6];
+}
+
+static double seconds(std::chrono::steady_clock::time_point start){
+    std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+    return took.count();
+}
+
+int main(int argc, char **argv){
+    std::vector<long> counts;
+    for(int i = 1; i < argc; i++){
+        counts.push_back(atol(argv[i]));
+    }
+    if(counts.empty()){
+        counts.push_back(10000);
+        counts.push_back(100000);
+        counts.push_back(1000000);
+    }
+
+    printf("entries\tlegacy_bytes/entry\tstore_bytes/entry\tlegacy_sort(s)\tstore_sort(s)\tby_size(s)\tby_mtime(s)\tnatural(s)\n");
+    for(int c = 0; c < counts.size(); c++){
+        long n = counts[c];
+
+        size_t before = live_bytes;
+        std::vector<LegacyFileData> *legacy = new std::vector<LegacyFileData>();
+        for(long i = 0; i < n; i++){
+            LegacyFileData file;
+            file.filename = syntheticName(i);
+            file.type = "other";
+            file.size = i % 1024;
+            file.units = "KB";
+            file.perms = "[rw] | [r] | [r]";
+            file.child_index = -1;
+            legacy->push_back(file);
+        }
+        double legacy_per_entry = (double)(live_bytes - before) / n;
+        auto start = std::chrono::steady_clock::now();
+        std::sort(legacy->begin(), legacy->end(), legacyCompare);
+        double legacy_sort = seconds(start);
+        delete legacy;
+
+        before = live_bytes;
+        EntryStore *store = new EntryStore();
+        for(long i = 0; i < n; i++){
+            std::string name = syntheticName(i);
+            store->add(name.c_str(), name.size(), TYPE_OTHER, S_IFREG | 0644, (i % 1024) * 1024, 1600000000 + i % 86400, false);
+        }
+        start = std::chrono::steady_clock::now();
+        SortOrder order;
+        store->sort(order);
+        double store_sort = seconds(start);
+        double store_per_entry = (double)(live_bytes - before) / n; //collation keys included
+
+        order.key = SORT_SIZE;
+        start = std::chrono::steady_clock::now();
+        store->sort(order);
+        double size_sort = seconds(start);
+
+        order.key = SORT_MTIME;
+        start = std::chrono::steady_clock::now();
+        store->sort(order);
+        double mtime_sort = seconds(start);
+
+        order.key = SORT_NAME;
+        order.natural = true;
+        start = std::chrono::steady_clock::now();
+        store->sort(order);
+        double natural_sort = seconds(start);
+        delete store;
+
+        printf("%ld\t%.1f\t%.1f\t%.4f\t%.4f\t%.4f\t%.4f\t%.4f\n", n, legacy_per_entry, store_per_entry,
+               legacy_sort, store_sort, size_sort, mtime_sort, natural_sort);
+    }
+    return 0;
+}
@@ -0,0 +1,153 @@
+//expands a folder tree with TreeWalker and checks the result against a plain
+//serial walk: same folders, same entries, and every child link pointing at
+//the right node. then leaves the tree the way the explorer leaves a folder
+//and opens one subfolder, which must be numbered as part of a new tree and
+//not after everything walked before. exits 1 if anything differs.
+//usage: bin/tree_bench [root] [depth] [threads]   (default: . 32, one thread per core)
+//a kernel or browser checkout makes a good root. drop caches between runs
+//(as root: "echo 3 > /proc/sys/vm/drop_caches") for cold numbers.
+#include <iostream>
+#include <map>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <stdlib.h>
+#include "scanner.h"
+#include "treewalker.h"
+
+typedef std::map<std::string, std::vector<std::string> > Listing; //folder -> its entries, sorted
+
+//one line per entry with everything the walker keeps
+static std::string describe(const std::string &name, bool is_dir, bool is_link, uint64_t size){
+    return name + (is_dir ? " d" : " f") + (is_link ? "l " : " ") + std::to_string(size);
+}
+
+static void serialWalk(const std::string &path, int depth, int max_depth, Listing *listing){
+    std::vector<ScanEntry> scanned;
+    scanDirectory(path, &scanned);
+    std::vector<std::string> &lines = (*listing)[path];
+    for(int i = 0; i < scanned.size(); i++){
+        const ScanEntry &entry = scanned[i];
+        if(depth > 0 && entry.name == ".."){
+            continue;
+        }
+        bool is_dir = (entry.kind == SCAN_DIR);
+        lines.push_back(describe(entry.name, is_dir, entry.is_link, is_dir ? 0 : entry.size));
+    }
+    std::sort(lines.begin(), lines.end());
+    for(int i = 0; i < scanned.size() && depth < max_depth; i++){
+        const ScanEntry &entry = scanned[i];
+        if(entry.kind == SCAN_DIR && !entry.is_link && entry.name != ".."){
+            serialWalk(path == "/" ? "/" + entry.name : path + "/" + entry.name, depth + 1, max_depth, listing);
+        }
+    }
+}
+
+static double seconds(std::chrono::steady_clock::time_point start){
+    std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+    return took.count();
+}
+
+int main(int argc, char **argv){
+    std::string root = argc > 1 ? argv[1] : ".";
+    int max_depth = argc > 2 ? atoi(argv[2]) : 32;
+    unsigned threads = argc > 3 ? atoi(argv[3]) : 0;
+
+    Listing serial;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    serialWalk(root, 0, max_depth, &serial);
+    double serial_time = seconds(start);
+
+    TreeWalker walker([]{}, threads);
+    std::vector<TreeNode> nodes;
+    std::vector<TreeWalker::Result> results;
+    start = std::chrono::steady_clock::now();
+    unsigned gen = walker.start(root, max_depth, SortOrder());
+    while(true){
+        bool done = walker.progress().done; //checked first, so the poll below sees everything
+        walker.poll(&results);
+        for(int i = 0; i < results.size(); i++){
+            if(results[i].generation == gen){
+                if(results[i].index >= nodes.size()){
+                    nodes.resize(results[i].index + 1);
+                }
+                nodes[results[i].index] = std::move(*results[i].node);
+            }
+            delete results[i].node;
+        }
+        if(done){
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    double walker_time = seconds(start);
+
+    Listing parallel;
+    long entries = 0;
+    int bad_links = 0;
+    for(int n = 0; n < nodes.size(); n++){
+        const EntryStore &list = nodes[n].entries;
+        std::vector<std::string> &lines = parallel[nodes[n].path];
+        for(size_t i = 0; i < list.size(); i++){
+            bool is_dir = (list.type(i) == TYPE_DIRECTORY);
+            lines.push_back(describe(list.name(i), is_dir, list.isLink(i), list.fileSize(i)));
+            int child = list.child(i);
+            if(child >= 0){
+                std::string expect = nodes[n].path == "/" ? "/" + std::string(list.name(i)) : nodes[n].path + "/" + list.name(i);
+                if(child >= nodes.size() || nodes[child].parent != n || nodes[child].path != expect
+                   || nodes[child].depth != nodes[n].depth + 1){
+                    bad_links++;
+                }
+            }
+        }
+        std::sort(lines.begin(), lines.end());
+        entries += list.size();
+    }
+
+    //cancel() is what leaving the folder does, open() a click on a subfolder.
+    //the explorer sizes its node list by the index it gets
+    int opened = -1;
+    int reopened_index = -1;
+    walker.cancel();
+    unsigned open_gen = walker.open(root, 0, 1, SortOrder(), &opened);
+    while(true){
+        bool done = walker.progress().done;
+        walker.poll(&results);
+        for(int i = 0; i < results.size(); i++){
+            if(results[i].generation == open_gen){
+                reopened_index = results[i].index;
+            }
+            delete results[i].node;
+        }
+        if(done){
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    bool renumbered = opened == 1 && reopened_index == 1;
+
+    bool same = (serial == parallel) && bad_links == 0;
+    std::cout << "folders\tentries\tserial(s)\twalker(s)\tthreads\tidentical\n";
+    std::cout << nodes.size() << "\t" << entries << "\t" << serial_time << "\t" << walker_time << "\t"
+              << (threads ? threads : std::max(2u, std::thread::hardware_concurrency())) << "\t"
+              << (same ? "yes" : "NO") << "\n";
+    if(!renumbered){
+        std::cout << "folder opened after cancel() got node " << opened << " (" << reopened_index
+                  << " on arrival), the node list would grow to that\n";
+        return 1;
+    }
+    if(!same){
+        std::cout << "serial walk has " << serial.size() << " folders, walker " << parallel.size()
+                  << ", " << bad_links << " bad child links\n";
+        for(Listing::iterator it = serial.begin(); it != serial.end(); ++it){
+            if(parallel.count(it->first) == 0 || parallel[it->first] != it->second){
+                std::cout << "first difference in " << it->first << "\n";
+                break;
+            }
+        }
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+//classification throughput of the old strstr-over-three-lists classifier
+//against the perfect-hash table, over generated names, plus a set of names
+//the old one got wrong. exits 1 if one of those comes out wrong.
+//usage: bin/type_bench [names] [config]   (default: 5000000, no config)
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "filetypes.h"
+
+static const char *WORDS[] = { "report", "draft", "IMG_2041", "backup", "notes", "Invoice", "main", "final",
+                               "photo", "scan", "video", "archive", "test", "build", "Makefile", "readme" };
+static const char *EXTENSIONS[] = { ".txt", ".JPG", ".pdf", ".tar.gz", ".cpp", ".h", ".mp4", "", ".jpeg",
+                                    ".py", ".cpp.bak", ".png_old", ".MKV", ".json", ".o", ".verylongext" };
+
+//convertToUsableType as it was before the table
+static FileType legacyType(const char *filename, mode_t mode){
+    static const char *img[] = {".jpg", ".jpeg", ".png", ".tif", ".tiff", ".gif"};
+    static const char *vid[] = {".mp4", ".mov", ".mkv", ".avi", ".webm"};
+    static const char *code[] = {".h", ".c", ".cpp", ".py", ".java", ".js"};
+    for (int i = 0; i < sizeof(img) / sizeof(img[0]); i++) {
+        if (strstr(filename, img[i]) != NULL) {
+            return TYPE_IMAGE;
+        }
+    }
+    for (int i = 0; i < sizeof(vid) / sizeof(vid[0]); i++) {
+        if (strstr(filename, vid[i]) != NULL) {
+            return TYPE_VIDEO;
+        }
+    }
+    for (int i = 0; i < sizeof(code) / sizeof(code[0]); i++) {
+        if (strstr(filename, code[i]) != NULL) {
+            return TYPE_CODE;
+        }
+    }
+    if(mode & (S_IXUSR | S_IXGRP | S_IXOTH)){
+        return TYPE_EXECUTABLE;
+    }
+    return TYPE_OTHER;
+}
+
+static double millis(std::chrono::steady_clock::time_point start){
+    std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - start;
+    return took.count();
+}
+
+int main(int argc, char **argv){
+    size_t count = argc > 1 ? atol(argv[1]) : 5000000;
+    if(argc > 2){
+        printf("%s: %d extensions\n", argv[2], loadFileTypes(argv[2]));
+    }
+
+    struct Case { const char *name; mode_t mode; FileType type; };
+    static const Case cases[] = {
+        { "photo.png", 0644, TYPE_IMAGE },       { "IMG_2041.JPG", 0644, TYPE_IMAGE },
+        { "clip.MkV", 0644, TYPE_VIDEO },        { "main.cpp", 0644, TYPE_CODE },
+        { "main.cpp.bak", 0644, TYPE_OTHER },    { "photo.png_old", 0644, TYPE_OTHER },
+        { "my.jpg.folder.txt", 0644, TYPE_OTHER }, { "notes.conf", 0644, TYPE_OTHER },
+        { "build.sh", 0755, TYPE_CODE },         { "a.out", 0755, TYPE_EXECUTABLE },
+        { "Makefile", 0644, TYPE_UNKNOWN },      { "configure", 0755, TYPE_EXECUTABLE },
+        { ".bashrc", 0644, TYPE_UNKNOWN },       { ".hidden.png", 0644, TYPE_IMAGE },
+        { "trailing.", 0644, TYPE_OTHER },       { "x.averyverylongextension", 0644, TYPE_OTHER },
+        { "x.c", 0644, TYPE_CODE },              { "x.d", 0644, TYPE_CODE },
+    };
+    int wrong = 0;
+    for(int i = 0; i < sizeof(cases) / sizeof(cases[0]) && argc <= 2; i++){
+        FileType got = classifyFile(cases[i].name, strlen(cases[i].name), cases[i].mode);
+        if(got != cases[i].type){
+            printf("%s: type %d, expected %d\n", cases[i].name, got, cases[i].type);
+            wrong++;
+        }
+    }
+
+    //names packed into one arena, the way EntryStore holds them
+    std::vector<char> arena;
+    std::vector<size_t> offsets, lengths;
+    std::vector<mode_t> modes;
+    unsigned seed = 1;
+    for(size_t i = 0; i < count; i++){
+        seed = seed * 1103515245 + 12345;
+        char name[96];
+        int len = snprintf(name, sizeof(name), "%s_%zu%s", WORDS[(seed >> 8) % 16], i, EXTENSIONS[(seed >> 16) % 16]);
+        offsets.push_back(arena.size());
+        lengths.push_back(len);
+        arena.insert(arena.end(), name, name + len + 1);
+        modes.push_back((seed >> 24) % 8 == 0 ? 0755 : 0644);
+    }
+
+    size_t tally[7] = { 0 };
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < count; i++){
+        tally[classifyFile(&arena[offsets[i]], lengths[i], modes[i])]++;
+    }
+    double table_ms = millis(start);
+
+    size_t legacy_tally[7] = { 0 };
+    start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < count; i++){
+        legacy_tally[legacyType(&arena[offsets[i]], modes[i])]++;
+    }
+    double legacy_ms = millis(start);
+
+    printf("%zu names\n", count);
+    printf("  table:   %8.1f ms  %6.1f M names/s\n", table_ms, count / table_ms / 1000);
+    printf("  strstr:  %8.1f ms  %6.1f M names/s\n", legacy_ms, count / legacy_ms / 1000);
+    printf("  image %zu (was %zu), video %zu (%zu), code %zu (%zu), executable %zu (%zu), other %zu (%zu), unknown %zu\n",
+           tally[TYPE_IMAGE], legacy_tally[TYPE_IMAGE], tally[TYPE_VIDEO], legacy_tally[TYPE_VIDEO],
+           tally[TYPE_CODE], legacy_tally[TYPE_CODE], tally[TYPE_EXECUTABLE], legacy_tally[TYPE_EXECUTABLE],
+           tally[TYPE_OTHER], legacy_tally[TYPE_OTHER], tally[TYPE_UNKNOWN]);
+    if(wrong > 0){
+        printf("%d names classified wrong\n", wrong);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,41 @@
+#ifndef ASYNCSTAT_H
+#define ASYNCSTAT_H
+
+#include <vector>
+#include <stdint.h>
+#include <sys/types.h>
+
+//how a batch of metadata requests gets answered
+enum StatBackend {
+    STAT_SYNC,    //one fstatat/statx at a time on the calling thread
+    STAT_THREADS, //worker threads sharing the batch
+    STAT_URING    //IORING_OP_STATX, only when built with IO_URING=1
+};
+
+struct StatJob {
+    const char *name; //relative to the directory fd, must outlive the batch
+    bool follow;      //resolve symlinks
+    bool ok;
+    uint64_t size;
+    mode_t mode;
+    int64_t mtime; //seconds since the epoch
+};
+
+//single size+mode+mtime lookup relative to dirfd
+bool statAt(int dirfd, const char *name, bool follow, uint64_t *size, mode_t *mode, int64_t *mtime);
+
+//answers every job in the batch, keeping many requests in flight on
+//high-latency filesystems. small batches are always done synchronously.
+void statJobs(int dirfd, std::vector<StatJob> *jobs);
+
+//backend used for large batches. defaults to STAT_URING when compiled in
+//(falling back to STAT_THREADS if the kernel refuses it), else STAT_THREADS.
+//safe to call from any thread.
+void setStatBackend(StatBackend backend);
+StatBackend statBackend();
+
+//benchmarks only: every stat answers this much later, like on a fuse or
+//network mount. 0 (the default) turns it off.
+void setStatDelay(unsigned microseconds);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef COLLATE_H
+#define COLLATE_H
+
+#include <vector>
+#include <stddef.h>
+
+//what a listing is ordered by. anything but SORT_NAME keeps folders on top.
+enum SortKey : unsigned char {
+    SORT_NAME,
+    SORT_SIZE,
+    SORT_MTIME,
+    SORT_TYPE
+};
+
+struct SortOrder {
+    SortKey key;
+    bool natural;    //digit runs compare by value, "file2" before "file10"
+    bool descending;
+
+    SortOrder() : key(SORT_NAME), natural(false), descending(false) {}
+    bool operator==(const SortOrder &other) const {
+        return key == other.key && natural == other.natural && descending == other.descending;
+    }
+    bool operator!=(const SortOrder &other) const { return !(*this == other); }
+};
+
+//appends the collation key of name to keys and returns its length. keys of two
+//names compare with memcmp (shorter first on a tie) in the order the names
+//should be listed: case-folded, and with natural on, every digit run becomes
+//'0', its significant digit count and the digits, so longer numbers sort later.
+size_t appendCollationKey(std::vector<unsigned char> *keys, const char *name, size_t len, bool natural);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef DIRWATCHER_H
+#define DIRWATCHER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include "scanner.h"
+
+#define WATCH_SETTLE_MS 40     //quiet time before a burst of events is handed over
+#define WATCH_MAX_DELAY_MS 250 //never hold changes back longer than this during a storm
+#define WATCH_RELIST_NAMES 2000 //more changed names than this in one folder and it is read whole instead
+
+//what happened to one watched folder since the last poll
+struct FolderChanges {
+    int node;                       //what the folder was watched as
+    unsigned generation;            //clear() since it was watched drops it
+    bool relist;                    //events were lost, entries is the whole folder now
+    std::vector<std::string> names; //every name that changed, existing or not
+    std::vector<ScanEntry> entries; //how the ones that still exist look now
+};
+
+//follows the folders on screen with inotify on its own thread. events are
+//gathered per folder and name until things go quiet, the changed names are
+//stat'ed right there, and the main thread gets one batch per folder, so a
+//checkout touching thousands of files costs one update and not thousands.
+//past WATCH_RELIST_NAMES the folder is listed again with the batched
+//scanner rather than stat'ed name by name.
+class DirWatcher {
+    public:
+        //wake is called from the watcher thread when changes are ready
+        explicit DirWatcher(std::function<void()> wake);
+        ~DirWatcher();
+
+        //node is whatever the caller wants the folder's changes tagged with
+        void watch(int node, const std::string &path);
+        void unwatch(int node);
+        //stops watching everything, returns the generation new watches carry
+        unsigned clear();
+
+        //main thread only
+        bool poll(std::vector<FolderChanges> *changes);
+
+    private:
+        struct Watch {
+            int node;
+            std::string path;
+            unsigned generation;
+        };
+
+        void run();
+        void flush();
+
+        std::function<void()> wake;
+        int inotify_fd;
+        int wake_pipe[2]; //written to stop the thread
+
+        std::mutex lock;
+        std::map<int, Watch> watches; //by inotify watch descriptor
+        std::map<int, int> node_watch; //node -> watch descriptor
+        unsigned generation;
+        std::vector<FolderChanges> ready;
+
+        //watcher thread only: changed names per watch descriptor
+        std::map<int, std::set<std::string> > pending;
+        std::set<int> overflowed; //too many names to stat one by one, relisted
+        bool lost_events;
+
+        std::thread thread;
+};
+
+#endif
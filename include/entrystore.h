@@ -0,0 +1,101 @@
+#ifndef ENTRYSTORE_H
+#define ENTRYSTORE_H
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "filedata.h"
+#include "collate.h"
+
+//the entries of one folder, stored column by column. names are packed
+//back to back (NUL terminated) into one arena, everything else is a small
+//fixed-width value, so an entry costs a few dozen bytes instead of a handful
+//of std::strings. display text is formatted from these when a row is drawn.
+class EntryStore {
+    public:
+        EntryStore() : keys_natural(false), changes(0) {}
+
+        size_t size() const { return types.size(); }
+        bool empty() const { return types.empty(); }
+        void clear();
+        void reserve(size_t entries, size_t name_bytes);
+
+        void add(const char *name, size_t len, FileType type, mode_t mode, uint64_t bytes, int64_t mtime, bool is_link);
+
+        const char *name(size_t i) const { return &names[name_offsets[i]]; }
+        size_t nameLength(size_t i) const { return name_lengths[i]; }
+        //what the name said, or what sniffing found for a TYPE_UNKNOWN entry
+        FileType type(size_t i) const { return (FileType)(types[i] >> 4 ? (types[i] >> 4) - 1 : types[i]); }
+        //records what the contents of a TYPE_UNKNOWN entry say. the entry
+        //keeps its place, sorting by type still goes by the name.
+        void setSniffedType(size_t i, FileType type) { types[i] = (types[i] & 0x0f) | ((type + 1) << 4); }
+        mode_t mode(size_t i) const { return modes[i]; }
+        uint64_t fileSize(size_t i) const { return sizes[i]; }
+        int64_t modifiedTime(size_t i) const { return mtimes[i]; }
+        bool isLink(size_t i) const { return links[i] != 0; } //type and mode are the target's
+
+        //tree node this folder was expanded into, -1 if none
+        int child(size_t i) const { return children[i]; }
+        void setChild(size_t i, int list) { children[i] = list; }
+
+        //puts the entries in the given order and remembers it. each entry's
+        //collation key is built once and kept, so re-sorting by another key
+        //only sorts. large folders are sorted on several threads.
+        void sort(const SortOrder &order);
+        const SortOrder &sortOrder() const { return order; }
+        //moves the entries of other in, keeping this sorted. other is re-sorted
+        //first if it was sorted some other way. an empty store just takes
+        //other over, a tail that goes after everything is only appended and
+        //a small one is placed by search, only a big interleaved one builds
+        //records for the whole store.
+        void mergeSorted(EntryStore &other);
+        //applies a diff: every entry named in names (all of them if all is set)
+        //is dropped, then fresh (what those names are now) is merged in. a
+        //folder that is still a folder keeps its child link, children whose
+        //folder went away are added to dropped.
+        void update(const std::vector<std::string> &names, bool all, EntryStore &fresh, std::vector<int> *dropped);
+
+        //a number no other contents of any store had, new whenever entries were
+        //added, dropped or reordered. lets things keyed by entry index notice
+        //they are stale.
+        uint64_t version() const;
+
+        //bytes held by the columns, capacity included
+        size_t memoryUsage() const;
+
+    private:
+        struct SortRecord;
+        class PrefixLess;
+        class RecordLess;
+        void updateKeys();
+        void makeRecord(size_t i, SortRecord *record) const;
+        void makeRecords(std::vector<SortRecord> *records) const;
+        void loadPrefix(SortRecord *record, size_t depth) const;
+        int compareKeys(uint32_t a, uint32_t b) const;
+        void refineTies(SortRecord *first, SortRecord *last, size_t depth, const PrefixLess &less) const;
+        void permute(const std::vector<uint32_t> &from);
+        void compactArenas();
+
+        std::vector<char> names;
+        std::vector<uint32_t> name_offsets;
+        std::vector<uint8_t> name_lengths; //NAME_MAX is 255
+        std::vector<uint8_t> types;        //FileType, sniffed type + 1 in the high nibble
+        std::vector<uint32_t> modes;       //raw st_mode
+        std::vector<uint64_t> sizes;       //bytes
+        std::vector<int64_t> mtimes;       //seconds since the epoch
+        std::vector<uint8_t> links;
+        std::vector<int32_t> children;
+
+        //collation keys, filled in by sort() and only rebuilt when the natural
+        //flag changes. entries added since then have no key yet.
+        std::vector<unsigned char> keys;
+        std::vector<uint32_t> key_offsets;
+        std::vector<uint16_t> key_lengths; //natural keys can grow past 255
+        bool keys_natural;
+        SortOrder order;
+        mutable uint64_t changes; //version(), 0 until asked after a change
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef FILEDATA_H
+#define FILEDATA_H
+
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "scanner.h"
+#include "collate.h"
+
+class EntryStore;
+
+//what an entry is shown as, picks the icon
+enum FileType : unsigned char {
+    TYPE_DIRECTORY,
+    TYPE_EXECUTABLE,
+    TYPE_IMAGE,
+    TYPE_VIDEO,
+    TYPE_CODE,
+    TYPE_OTHER,
+    TYPE_UNKNOWN //no extension, not looked inside yet
+};
+
+enum SizeUnit : unsigned char {
+    UNIT_B,
+    UNIT_KB,
+    UNIT_MB,
+    UNIT_GB
+};
+
+#define PERMS_TEXT_SIZE 24 //"[rwx] | [rwx] | [rwx]" plus the terminator
+
+void updateFileList(EntryStore *files, std::string filepath, bool recur, const SortOrder &order);
+void addScanEntry(EntryStore *files, const ScanEntry &entry);
+void fitFilesizeToUnit(uint64_t bytes, double *size, SizeUnit *units);
+const char *unitName(SizeUnit units);
+void setFilePermField(char *perms, mode_t mode);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef FILETYPES_H
+#define FILETYPES_H
+
+#include <string>
+#include <stddef.h>
+#include <sys/types.h>
+#include "filedata.h"
+
+//what a file is, from the extension after its last dot, looked up in a
+//perfect-hash table built at compile time. executables without a known
+//extension are TYPE_EXECUTABLE. files without any extension are
+//TYPE_UNKNOWN until something looks inside them (sniffFileType).
+FileType classifyFile(const char *name, size_t len, mode_t mode);
+
+//extra extensions, one type per line followed by its extensions:
+//    image heic avif
+//    code zig
+//    other ts          (not shown as anything)
+//they win over the built-in ones. has to be called before any folder is
+//read, the table is read without locks afterwards. returns how many
+//extensions were taken, -1 if the file could not be opened.
+int loadFileTypes(const std::string &file);
+//$XDG_CONFIG_HOME/os-fileexplorer/filetypes (~/.config without it)
+std::string fileTypesFile();
+//the name the config uses for a type, "folder" and "unknown" for the two
+//it has no word for
+const char *typeName(FileType type);
+
+//looks at the first bytes of a file (PNG, JPEG, ELF, #!...), TYPE_OTHER if
+//they say nothing
+FileType sniffFileType(const char *path);
+
+#endif
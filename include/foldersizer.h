@@ -0,0 +1,79 @@
+#ifndef FOLDERSIZER_H
+#define FOLDERSIZER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <stdint.h>
+
+#define FOLDER_SIZES_MAX 32768 //totals kept, the oldest (deepest of a walk, they finish first) go first
+
+//disk usage of a folder and everything below it
+struct FolderSize {
+    uint64_t bytes; //allocated, like du
+    uint64_t files;
+    bool done;      //false while the total is still growing
+};
+
+//du on a pool of threads. every folder below the one asked for is a task of
+//its own, sizes roll up the tree as folders finish. a file with several
+//hard links is counted once per measured folder, and other filesystems
+//mounted below it are left out (du -x). up to FOLDER_SIZES_MAX folder
+//totals are kept, so going into one that was already counted as part of
+//its parent is instant.
+class FolderSizer {
+    public:
+        //wake is called from a pool thread when a measured folder is done.
+        //threads 0 picks one per core (at least 4, the work is mostly waiting).
+        explicit FolderSizer(std::function<void()> wake, unsigned threads = 0);
+        ~FolderSizer();
+
+        //queues path unless it is known or being counted already
+        void measure(const std::string &path);
+        //what is known about path so far, false if nothing is
+        bool size(const std::string &path, FolderSize *out);
+        //stops every walk and drops what was counted
+        void forget();
+        //something in path changed: drops its total and those of every folder
+        //above it, and stops the walks counting them. they are measured again
+        //when next asked for.
+        void forget(const std::string &path);
+        bool busy() const { return walks > 0; }
+
+    private:
+        struct Walk;
+        struct Folder;
+
+        void run();
+        void count(Folder *folder);
+        void finish(Folder *folder);
+        void keep(const std::string &path, const FolderSize &total);
+
+        std::function<void()> wake;
+        std::vector<std::thread> threads;
+
+        std::mutex lock; //everything below
+        std::condition_variable work_ready;
+        std::vector<Folder *> work; //deepest last, taken from the back
+        bool quitting;
+        std::vector<Walk *> active;
+        std::unordered_map<std::string, Folder *> counting;
+        struct Known {
+            FolderSize size;
+            uint64_t stamp; //which entry of kept_order is this one's
+        };
+        std::unordered_map<std::string, Known> sizes;
+        std::deque<std::pair<std::string, uint64_t> > kept_order; //oldest first, may name dropped ones
+        uint64_t next_stamp;
+
+        std::atomic<int> walks;
+};
+
+#endif
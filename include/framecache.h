@@ -0,0 +1,69 @@
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+#include <functional>
+#include <SDL.h>
+#include "resourcepool.h"
+
+struct FrameStats {
+    unsigned drawn;   //frames where something was drawn again
+    unsigned skipped; //frames where nothing had changed, not even presented
+    int last_area;    //pixels drawn again in the last drawn frame
+};
+
+//keeps what is on screen in a target texture, so a frame only draws the
+//parts that changed (the damage, one rectangle around everything marked)
+//and a frame where nothing changed is not drawn or presented at all. the
+//window's own back buffer cannot be kept, it is undefined after a present.
+//the chrome (corner icons) is composed into a second texture once and
+//copied over every frame. without render target support every damaged
+//frame draws everything, unchanged frames are still skipped.
+class FrameCache {
+    public:
+        FrameCache(ResourcePool *pool, int w, int h);
+
+        //main thread only
+        void damage(const SDL_Rect &rect);
+        void damageAll();
+        bool damaged() const { return area.w > 0; }
+        //the window was uncovered, it needs the frame again but nothing changed
+        void exposed();
+        //the renderer lost its target textures, everything is drawn again
+        void lost();
+
+        //the chrome is drawn by draw, into its texture at the next begin().
+        //nothing happens if key is the one composed last
+        void composeChrome(unsigned key, std::function<void()> draw);
+
+        //false if nothing is damaged. else drawing goes to the frame, clipped
+        //to the damage, which is filled with background
+        bool begin(SDL_Renderer *renderer, const SDL_Color &background);
+        //what begin() is drawing, rows and bars outside it need not be drawn
+        const SDL_Rect &drawing() const { return area; }
+        bool touches(const SDL_Rect &rect) const { return SDL_HasIntersection(&rect, &area); }
+        //after drawing: the chrome on top, then the frame to the window.
+        //called every frame, also when begin() said false (counts it as
+        //skipped, or presents the old frame again after an expose)
+        void end(SDL_Renderer *renderer);
+
+        FrameStats stats() const { return counts; }
+
+    private:
+        void setUp(SDL_Renderer *renderer);
+        void drawChrome(SDL_Renderer *renderer);
+
+        ResourcePool *pool;
+        int w, h;
+        bool ready;       //setUp ran, textures exist if they could be made
+        TextureHandle frame;
+        TextureHandle chrome;
+        std::function<void()> draw_chrome;
+        unsigned chrome_key;
+        bool chrome_drawn;
+        SDL_Rect area;    //damage of the next frame, w 0 if none
+        bool drawing_now;
+        bool shown;       //the window shows the current frame
+        FrameStats counts;
+};
+
+#endif
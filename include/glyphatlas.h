@@ -0,0 +1,39 @@
+#ifndef GLYPHATLAS_H
+#define GLYPHATLAS_H
+
+#include <vector>
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include "resourcepool.h"
+
+//every glyph of the font rasterized once into one shared texture. strings are
+//drawn as textured quads, queued up and sent in a single SDL_RenderGeometry
+//call per flush, so no per-string surfaces or textures are ever created.
+class GlyphAtlas {
+    public:
+        explicit GlyphAtlas(ResourcePool *pool);
+
+        bool load(SDL_Renderer *renderer, const char *font_path, int pt_size, SDL_Color color);
+        int measure(const char *text, size_t len);
+        void draw(const char *text, size_t len, int x, int y);
+        void flush(SDL_Renderer *renderer);
+        int lineHeight();
+
+    private:
+        struct Glyph {
+            SDL_Rect src; //cell in the atlas texture
+            int advance;
+        };
+
+        //text is handed to SDL_ttf byte by byte (latin-1), same as TTF_RenderText did
+        Glyph glyphs[256]; //zeroed until load() fills them
+        ResourcePool *pool;
+        TextureHandle texture;
+        int atlas_w;
+        int atlas_h;
+        int line_height;
+        std::vector<SDL_Vertex> vertices;
+        std::vector<int> indices;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef ICONCACHE_H
+#define ICONCACHE_H
+
+#include <string>
+#include <SDL.h>
+#include "filedata.h"
+#include "resourcepool.h"
+
+//every image in resrc/images, by the slot it occupies in the icon atlas
+enum IconId : unsigned char {
+    ICON_DIR,
+    ICON_EXE,
+    ICON_IMG,
+    ICON_VID,
+    ICON_CODE,
+    ICON_OTHER,
+    ICON_TIPS,
+    ICON_RECUR_ON,
+    ICON_RECUR_OFF,
+    ICON_UST,
+    ICON_COUNT
+};
+
+//loads all icons once at startup into a single texture. entries only keep
+//an IconId, and drawing is a copy out of the shared texture.
+class IconCache {
+    public:
+        explicit IconCache(ResourcePool *pool);
+
+        bool load(SDL_Renderer *renderer, const std::string &image_dir);
+        void draw(SDL_Renderer *renderer, IconId icon, const SDL_Rect *dest);
+
+    private:
+        ResourcePool *pool;
+        TextureHandle texture;
+        SDL_Rect cells[ICON_COUNT];
+        bool present[ICON_COUNT]; //missing files are simply not drawn
+};
+
+IconId iconForType(FileType type);
+
+#endif
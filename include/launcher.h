@@ -0,0 +1,55 @@
+#ifndef LAUNCHER_H
+#define LAUNCHER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <functional>
+#include <sys/types.h>
+
+#define LAUNCH_OPENER "xdg-open"
+
+//a file handed to the opener that has finished
+struct LaunchResult {
+    std::string path;
+    int status; //exit code, 128 + signal if it was killed
+};
+
+//opens files with LAUNCH_OPENER without stopping the explorer. children are
+//started with posix_spawn, which on linux shares the address space until the
+//exec (vfork), so starting one costs the same however much memory the
+//explorer holds, and an exec that fails is reported here instead of leaving
+//a copy of the explorer running. a SIGCHLD handler and a small thread wake
+//the event loop when one ends, reap() then collects it, so none are left
+//as zombies. one Launcher per process, it owns SIGCHLD.
+class Launcher {
+    public:
+        //wake is called from the watcher thread when a child has ended
+        explicit Launcher(std::function<void()> wake, const std::string &opener = LAUNCH_OPENER);
+        ~Launcher();
+
+        //starts the opener once for each path, without waiting for any of
+        //them. false if one could not be started, error then says which and
+        //why (the others are still started).
+        bool open(const std::vector<std::string> &paths, std::string *error);
+        //main thread: the children that ended since the last call
+        void reap(std::vector<LaunchResult> *ended);
+
+        size_t running() const { return children.size(); }
+        //time posix_spawn took, last and slowest, microseconds
+        double lastLaunchUs() const { return last_us; }
+        double worstLaunchUs() const { return worst_us; }
+
+    private:
+        void run();
+
+        std::function<void()> wake;
+        std::string opener;
+        std::map<pid_t, std::string> children; //main thread only
+        std::thread watcher;
+        double last_us;
+        double worst_us;
+};
+
+#endif
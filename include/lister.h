@@ -0,0 +1,47 @@
+#ifndef LISTER_H
+#define LISTER_H
+
+#include <string>
+#include <stddef.h>
+
+#define LIST_BUFFER_BYTES (1 << 20) //output goes out in writes of this size
+#define LIST_BACKLOG 64             //read folders waiting to be written, the walker waits beyond that
+
+enum ListFormat {
+    LIST_NDJSON,
+    LIST_BINARY
+};
+
+//binary format, host byte order, no padding:
+//  header: "OSFXLIST" then uint32 version (LIST_BINARY_VERSION)
+//  folder: uint8 'D', uint32 path length, path, uint32 entries that follow
+//  entry:  uint8 type (FileType), uint8 1 if it is a link, uint16 name
+//          length, uint32 mode, uint64 size, int64 mtime, name
+//names are not terminated. folders have size and mtime 0 and only the type
+//bits of their mode.
+#define LIST_BINARY_MAGIC "OSFXLIST"
+#define LIST_BINARY_VERSION 1
+
+struct ListTotals {
+    size_t folders;
+    size_t entries;
+    size_t bytes; //written to the output
+};
+
+//streams path to fd without a window: the folder alone with max_depth 0,
+//else the tree below it read by the parallel walker, max_depth levels deep.
+//folders come out in whatever order the walker finishes them, each with its
+//entries sorted by name, and are dropped once written. memory is bounded by
+//LIST_BACKLOG written folders, TREE_QUEUED_MAX queued ones and the folders
+//on the paths being read, not by the size of the tree. ndjson has one
+//object per entry:
+//  {"path":"/home/a/b.png","type":"image","size":"12 KB","bytes":12345,
+//   "perms":"[rw] | [r] | [r]","mtime":1621209600,"link":false}
+//folders have no perms, size or mtime. paths are bytes and JSON strings are
+//UTF-8, so each byte of a path that is not well-formed UTF-8 comes out as
+//U+FFFD: such a path can be shown but not opened from the ndjson, the binary
+//format keeps the bytes as they are.
+//false if writing failed (totals says how far it got).
+bool streamListing(const std::string &path, int max_depth, ListFormat format, int fd, ListTotals *totals);
+
+#endif
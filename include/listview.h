@@ -0,0 +1,77 @@
+#ifndef LISTVIEW_H
+#define LISTVIEW_H
+
+#include <vector>
+#include <string>
+#include "treewalker.h"
+
+#define ROW_HEIGHT 24
+#define ROW_INDENT 48   //extra x offset per level of recursion
+#define ROW_OVERSCAN 4  //rows kept ready above and below the viewport
+#define SCROLL_EASE 0.35f //share of the remaining distance covered per 16ms frame
+
+//one line of the list as displayed, pointing into AppData::nodes
+struct RowRef {
+    int node;  //which folder of the tree
+    int index; //entry within that folder
+    int depth; //0 for the current folder, 1 for its expanded children...
+};
+
+//pixel scroll offset of the list. input moves target, drawing follows y,
+//which eases towards target a little every frame.
+struct ScrollState {
+    float y = 0;
+    float target = 0;
+
+    int offset() const { return (int)y; }
+    bool moving() const { return y != target; }
+};
+
+//move the target by delta / to an absolute position, clamped to the content
+void scrollBy(ScrollState *scroll, float delta, int content_h, int view_h);
+void scrollTo(ScrollState *scroll, float target, int content_h, int view_h);
+//jump straight to the top without animating (new folder)
+void scrollReset(ScrollState *scroll);
+//advances the animation by elapsed_ms
+void scrollStep(ScrollState *scroll, unsigned elapsed_ms);
+
+//ROW LAYOUT
+//rows are never stored: row r sits at r * ROW_HEIGHT, and which entry it
+//shows is looked up in TreeNode::row_sums. every loaded node keeps a Fenwick
+//tree over its entries, entry i weighing one row plus all the rows of its
+//child node while that is expanded. finding a row walks down from the root,
+//expanding or collapsing a folder walks up to it, each step costing
+//log(entries) of that node, so a subtree coming or going never relayouts
+//everything below it.
+
+//points the children of node back at their entry after it was read or
+//re-sorted, making placeholders for the ones still being read
+void linkChildren(std::vector<TreeNode> *nodes, int node);
+//rebuilds the layout of one loaded node from its entries and the children
+//already in, and passes the change in its row count up to the root
+void layoutNode(std::vector<TreeNode> *nodes, int node);
+//every node at once, children before parents (after re-sorting all of them)
+void layoutTree(std::vector<TreeNode> *nodes);
+//shows or hides the rows of a loaded node under its parent entry
+void setExpanded(std::vector<TreeNode> *nodes, int node, bool expanded);
+
+//FILTER
+//with a filter an entry only gets a row if its name contains the filter
+//text, or if it is a folder with matching rows below it, which stays as
+//the path to them. lay the node out after changing it.
+//marks the entries of node matching query, empty query shows all again
+void filterNode(std::vector<TreeNode> *nodes, int node, const std::string &query);
+//builds the node's index ahead of time, so the first keystroke is not slow
+void prepareFilter(std::vector<TreeNode> *nodes, int node);
+
+int rowCount(const std::vector<TreeNode> &nodes);
+//node, entry and depth of row r, 0 <= r < rowCount()
+RowRef findRow(const std::vector<TreeNode> &nodes, int r);
+
+//rows [first, last) intersecting a view_h tall viewport scrolled by scroll_y, plus overscan
+void visibleRows(int row_count, int scroll_y, int view_h, int *first, int *last);
+
+//row under viewport coordinate y, or -1
+int rowAt(int row_count, int scroll_y, int y);
+
+#endif
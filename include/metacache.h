@@ -0,0 +1,70 @@
+#ifndef METACACHE_H
+#define METACACHE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <stdint.h>
+#include <stddef.h>
+
+class EntryStore;
+
+#define CACHE_VERSION 2
+#define CACHE_MAX_BYTES (64u << 20)     //the file is trimmed to this, oldest folders first
+#define CACHE_MAX_FOLDER_ENTRIES 200000 //bigger folders are not worth keeping around
+
+//which folder, and how it looked when it was listed. a folder whose entries
+//were added, removed or renamed since has another mtime.
+struct DirStamp {
+    uint64_t dev;
+    uint64_t ino;
+    int64_t mtime_ns;
+};
+
+bool stampDirectory(const std::string &path, DirStamp *stamp);
+
+//folder listings kept between runs, so a folder seen before shows up without
+//a single stat and is only checked afterwards. the file is mapped and read
+//in place: a header, a table of fixed-width folder records sorted by inode,
+//fixed-width entry records and one blob of names. every region is checked
+//against the file size and a checksum before use, a file that fails is
+//ignored and replaced on the next save.
+class MetaCache {
+    public:
+        //file is usually cacheFile()
+        explicit MetaCache(const std::string &file);
+        ~MetaCache();
+
+        //$XDG_CACHE_HOME/os-fileexplorer/listings, or ~/.cache/... without it
+        static std::string cacheFile();
+
+        //fills entries if the cached listing of stamp's folder is still current
+        bool load(const DirStamp &stamp, EntryStore *entries);
+        //remembers a listing taken at stamp (stamp must be from before the read)
+        void store(const DirStamp &stamp, const EntryStore &entries);
+        //writes the new file next to the old one and swaps it in
+        bool save();
+
+    private:
+        struct Header;
+        struct FolderRecord;
+        struct EntryRecord;
+        struct Listing;
+        typedef std::pair<uint64_t, uint64_t> Key; //dev, inode
+
+        bool map();
+        void unmap();
+        const FolderRecord *find(const Key &key) const;
+        bool valid(const FolderRecord *folder) const;
+
+        std::string file;
+        const unsigned char *data; //mapped file, NULL if there is none usable
+        size_t data_size;
+        const FolderRecord *folders;
+        uint32_t folder_count;
+        std::map<Key, Listing *> stored;  //listings taken this run
+        std::map<Key, uint64_t> used;     //cached folders shown this run, by time
+};
+
+#endif
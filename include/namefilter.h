@@ -0,0 +1,54 @@
+#ifndef NAMEFILTER_H
+#define NAMEFILTER_H
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+
+class EntryStore;
+
+#define FILTER_INDEX_MIN 4096       //smaller folders are scanned, an index would not pay off
+#define FILTER_TRIGRAM_BUCKETS 65536 //trigrams are hashed down to this many posting lists
+#define FILTER_PADDING 16           //readable bytes the search may touch past a name
+
+//where needle starts in hay, or -1. both already case folded. reads up to
+//FILTER_PADDING bytes past hay + len, 16 positions are tested per step.
+long findFolded(const char *hay, size_t len, const char *needle, size_t needle_len);
+
+//lowercases ASCII, other bytes (UTF-8) are kept as they are
+void foldName(const char *name, size_t len, char *out);
+
+//answers "which entries of this folder have the text in their name" while
+//the user types. names are kept case folded in one arena, big folders also
+//get trigram posting lists, so a query only looks at names that have all of
+//its trigrams. a query extending the previous one only looks at what the
+//previous one matched. rebuilt by itself when the store changes.
+class NameIndex {
+    public:
+        NameIndex() : version(0), has_trigrams(false) {}
+
+        //builds everything a query on store needs, so typing does not have to
+        void prepare(const EntryStore &store);
+        //entries whose name contains query, ignoring ASCII case, in entry order
+        void match(const EntryStore &store, const std::string &query, std::vector<uint32_t> *matches);
+        void clear();
+
+        size_t memoryUsage() const;
+
+    private:
+        void rebuild(const EntryStore &store);
+        void buildTrigrams();
+        void candidates(const std::string &query, std::vector<uint32_t> *out) const;
+
+        uint64_t version; //EntryStore::version() the arena was built from
+        std::vector<char> folded;      //names lowercased, NUL separated, padded
+        std::vector<uint32_t> offsets; //name i is folded[offsets[i], offsets[i + 1] - 1)
+        bool has_trigrams;
+        std::vector<uint32_t> bucket_starts;  //postings of bucket b are bytes [starts[b], starts[b + 1])
+        std::vector<unsigned char> postings; //entry indexes, ascending varint gaps within a bucket
+        std::string last_query;
+        std::vector<uint32_t> last_matches;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef RESOURCEPOOL_H
+#define RESOURCEPOOL_H
+
+#include <stddef.h>
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+#define RESOURCE_BUDGET_BYTES (24u << 20) //texture memory, --texture-budget MB overrides
+
+class ResourcePool;
+
+//owns one texture made by a ResourcePool and destroys it when it goes away
+//or is reset. move only, like the texture it stands for.
+class TextureHandle {
+    public:
+        TextureHandle() : pool(NULL), texture(NULL), bytes(0) {}
+        TextureHandle(TextureHandle &&other);
+        TextureHandle &operator=(TextureHandle &&other);
+        ~TextureHandle() { reset(); }
+
+        void reset();
+        SDL_Texture *get() const { return texture; }
+        size_t size() const { return bytes; }
+        explicit operator bool() const { return texture != NULL; }
+
+    private:
+        friend class ResourcePool;
+        TextureHandle(ResourcePool *pool, SDL_Texture *texture, size_t bytes)
+            : pool(pool), texture(texture), bytes(bytes) {}
+        TextureHandle(const TextureHandle &) = delete;
+        TextureHandle &operator=(const TextureHandle &) = delete;
+
+        ResourcePool *pool;
+        SDL_Texture *texture;
+        size_t bytes;
+};
+
+//same for a font
+class FontHandle {
+    public:
+        FontHandle() : pool(NULL), font(NULL) {}
+        FontHandle(FontHandle &&other);
+        FontHandle &operator=(FontHandle &&other);
+        ~FontHandle() { reset(); }
+
+        void reset();
+        TTF_Font *get() const { return font; }
+        explicit operator bool() const { return font != NULL; }
+
+    private:
+        friend class ResourcePool;
+        FontHandle(ResourcePool *pool, TTF_Font *font) : pool(pool), font(font) {}
+        FontHandle(const FontHandle &) = delete;
+        FontHandle &operator=(const FontHandle &) = delete;
+
+        ResourcePool *pool;
+        TTF_Font *font;
+};
+
+struct ResourceCounts {
+    int textures;         //alive right now
+    size_t texture_bytes; //what they take, as uploaded (w * h * bytes per pixel)
+    size_t peak_bytes;
+    size_t budget;
+    int fonts;
+    unsigned refused;     //times fits() said no, each is an eviction by the asking cache
+};
+
+//every texture and font of the window comes from here, so what is alive and
+//how much memory it holds is always known. fixed assets (glyphs, icons) are
+//always given what they ask for; caches that can grow (thumbnails) ask fits()
+//before growing and reuse their least recently drawn space when it says no.
+//main thread only, and it has to outlive every handle it gave out.
+class ResourcePool {
+    public:
+        explicit ResourcePool(size_t budget = RESOURCE_BUDGET_BYTES);
+
+        TextureHandle createTexture(SDL_Renderer *renderer, Uint32 format, int access, int w, int h);
+        TextureHandle createTexture(SDL_Renderer *renderer, SDL_Surface *surface);
+        FontHandle openFont(const char *path, int pt_size);
+
+        //whether bytes more would stay within the budget
+        bool fits(size_t bytes);
+        ResourceCounts counts() const { return live; }
+
+    private:
+        friend class TextureHandle;
+        friend class FontHandle;
+        TextureHandle adopt(SDL_Texture *texture);
+
+        ResourceCounts live;
+};
+
+#endif
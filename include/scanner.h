@@ -0,0 +1,47 @@
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include <string>
+#include <functional>
+#include <vector>
+#include <stdint.h>
+#include <sys/types.h>
+
+//what an entry resolves to once symlinks and DT_UNKNOWN have been looked at
+enum ScanKind {
+    SCAN_FILE,
+    SCAN_DIR,
+    SCAN_OTHER //fifo, socket, device, dangling link
+};
+
+struct ScanEntry {
+    std::string name;
+    unsigned char d_type; //raw type from getdents64 (DT_REG, DT_LNK, DT_UNKNOWN...)
+    ScanKind kind;
+    bool is_link;
+    uint64_t size; //size, mode and mtime are only filled in for non-directories
+    mode_t mode;
+    int64_t mtime;
+};
+
+//reads every entry of dirpath (except ".") in large getdents64 batches and
+//stats non-directories relative to the directory fd. returns false if the
+//directory could not be opened.
+bool scanDirectory(const std::string &dirpath, std::vector<ScanEntry> *entries);
+
+//same scan, but hands over each getdents64 batch (already stat'ed) as soon as
+//it is read. the callback may take the entries out of the batch; returning
+//false stops the scan early.
+typedef std::function<bool(std::vector<ScanEntry> &batch)> ScanBatchCallback;
+bool scanDirectoryBatched(const std::string &dirpath, const ScanBatchCallback &deliver);
+
+//one entry of the open directory dirfd, resolved the way a scan would.
+//false if it does not exist (any more).
+bool scanEntryAt(int dirfd, const char *name, ScanEntry *entry);
+
+//just the names and raw d_type of everything in dirfd but "." and "..", no
+//stat and no allocation per entry. for walks that stat on their own terms.
+typedef std::function<void(const char *name, unsigned char d_type)> NameCallback;
+bool listNames(int dirfd, const NameCallback &visit);
+
+#endif
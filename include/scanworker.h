@@ -0,0 +1,58 @@
+#ifndef SCANWORKER_H
+#define SCANWORKER_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "entrystore.h"
+#include "spscqueue.h"
+
+struct ScanBatch {
+    unsigned generation; //which start() this belongs to
+    bool done;           //the listing is complete
+    EntryStore entries;  //everything read so far, sorted, replaces the last batch
+};
+
+//reads directories on its own thread and keeps what it read sorted there,
+//so the event loop never waits on the filesystem and never merges. the
+//first getdents batch goes out as soon as it is read, after that a new
+//listing is sent whenever the entries read since the last one are as many
+//as it held, so a folder of n entries costs the main thread log n swaps.
+class ScanWorker {
+    public:
+        //wake is called from the worker thread whenever a batch is ready
+        explicit ScanWorker(std::function<void()> wake);
+        ~ScanWorker();
+
+        //cancels the scan in progress (if any) and starts on path, sorting
+        //batches in order. returns the generation its batches will carry.
+        unsigned start(const std::string &path, const SortOrder &order);
+        void cancel();
+        //listings sent from now on are in order
+        void setOrder(const SortOrder &order);
+
+        //main thread only. caller owns (and deletes) the batch.
+        bool poll(ScanBatch **batch);
+
+    private:
+        void run();
+        bool deliver(ScanBatch *batch, unsigned gen);
+        SortOrder currentOrder();
+
+        std::function<void()> wake;
+        SpscQueue<ScanBatch *> results;
+        std::atomic<unsigned> generation;
+        std::mutex lock;
+        std::condition_variable wakeup;
+        std::string pending_path;
+        SortOrder pending_order;
+        bool has_pending;
+        bool quitting;
+        std::thread thread;
+};
+
+#endif
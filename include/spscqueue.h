@@ -0,0 +1,44 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <stddef.h>
+
+//fixed-size lock-free ring for exactly one producer thread and one consumer thread
+template <typename T>
+class SpscQueue {
+    public:
+        explicit SpscQueue(size_t capacity) : slots(capacity + 1), head(0), tail(0) {}
+
+        //producer side, false when full
+        bool push(const T &item){
+            size_t t = tail.load(std::memory_order_relaxed);
+            size_t next = (t + 1) % slots.size();
+            if(next == head.load(std::memory_order_acquire)){
+                return false;
+            }
+            slots[t] = item;
+            tail.store(next, std::memory_order_release);
+            return true;
+        }
+
+        //consumer side, false when empty
+        bool pop(T *item){
+            size_t h = head.load(std::memory_order_relaxed);
+            if(h == tail.load(std::memory_order_acquire)){
+                return false;
+            }
+            *item = slots[h];
+            head.store((h + 1) % slots.size(), std::memory_order_release);
+            return true;
+        }
+
+    private:
+        std::vector<T> slots;
+        std::atomic<size_t> head; //only written by the consumer
+        char pad[64];             //keeps head and tail on separate cache lines
+        std::atomic<size_t> tail; //only written by the producer
+};
+
+#endif
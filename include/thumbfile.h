@@ -0,0 +1,32 @@
+#ifndef THUMBFILE_H
+#define THUMBFILE_H
+
+#include <string>
+#include <stdint.h>
+
+//the parts of the freedesktop thumbnail spec that need no SDL: where a
+//thumbnail lives, whether it is still good, and writing one. pixels are
+//32-bit ARGB (0xAARRGGBB) throughout.
+
+#define THUMB_NORMAL_SIZE 128 //the spec's "normal" size
+
+//file:// URI of an absolute path, escaped like the spec wants it hashed
+std::string thumbnailUri(const std::string &path);
+//$XDG_CACHE_HOME/thumbnails/normal/<md5 of uri>.png (~/.cache without it)
+std::string thumbnailFile(const std::string &uri);
+std::string md5Hex(const std::string &data);
+
+//Thumb::MTime stored in a thumbnail, -1 if it has none or is no PNG
+int64_t thumbnailMTime(const std::string &file);
+//writes an RGBA PNG with Thumb::URI and Thumb::MTime, next to file first
+//and renamed over it so readers never see half of one
+bool writeThumbnail(const std::string &file, const uint32_t *pixels, int w, int h,
+                    const std::string &uri, int64_t mtime);
+
+//largest size with the same aspect as w x h that fits in max x max
+void fitSize(int w, int h, int max, int *fit_w, int *fit_h);
+//averages every source pixel into the destination pixel it falls in.
+//pitch is in pixels. dw, dh must not be larger than sw, sh.
+void shrinkPixels(const uint32_t *src, int sw, int sh, int pitch, uint32_t *dst, int dw, int dh);
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef THUMBNAILS_H
+#define THUMBNAILS_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <stdint.h>
+#include <SDL.h>
+#include "resourcepool.h"
+
+#define THUMB_SIZE 48                  //drawn into the 24px icon cell, room for hidpi
+#define THUMB_PAGE_SIZE 1024           //atlas page, (1024 / 48)^2 thumbnails each
+#define THUMB_QUEUE_MAX 256            //requests past this push the oldest out
+#define THUMB_UPLOADS_PER_FRAME 32
+#define THUMB_STALE_FRAMES 4           //a request not drawn again for this long is off screen, dropped
+#define THUMB_PARKED_MAX 64            //decodes kept while every cell is on screen, no requests past it
+
+//thumbnails of image files, decoded by a small pool of threads and kept in
+//a few atlas textures. only what is drawn gets requested, newest first, so
+//scrolling fast through thousands of photos only ever decodes what the
+//list stops on. the main thread does no more than a bounded number of
+//texture uploads per frame. pages are added while the pool's budget allows,
+//after that the least recently drawn thumbnail makes room, never one drawn
+//in this frame or the one before. a decode that finds no cell is parked
+//until one frees up instead of being decoded again, and while the parked
+//ones are at THUMB_PARKED_MAX nothing new is requested, so more previews
+//on screen than fit settle instead of evicting each other every frame.
+//thumbnails from the freedesktop cache are used
+//when still current, new ones are written there unless told otherwise.
+class ThumbnailCache {
+    public:
+        //wake is called from a pool thread when decodes are ready.
+        //threads 0 leaves one core to the main thread (at most 4 are used).
+        ThumbnailCache(ResourcePool *pool, std::function<void()> wake, unsigned threads = 0);
+        ~ThumbnailCache();
+
+        void setPersist(bool persist) { this->persist = persist; }
+
+        //main thread only. draws the thumbnail of path into dest, false if
+        //there is none (yet), in which case it is requested.
+        bool draw(SDL_Renderer *renderer, const std::string &path, int64_t mtime, const SDL_Rect *dest);
+        //once per frame: moves finished decodes into the atlas, returns how
+        //many (their rows look different now)
+        int upload(SDL_Renderer *renderer);
+        //decodes queued, running or waiting for upload
+        bool busy();
+
+    private:
+        struct Request {
+            std::string path;
+            int64_t mtime;
+        };
+        struct Decoded {
+            std::string path;
+            int64_t mtime;
+            int w, h;
+            std::vector<uint32_t> pixels; //ARGB, empty if the file could not be read
+        };
+        struct Slot {
+            int page;
+            SDL_Rect cell; //w and h are the thumbnail's, at most THUMB_SIZE
+            unsigned used; //frame it was last drawn in
+            std::string path;
+        };
+        struct Parked {
+            Decoded *decoded;
+            unsigned used; //frame it was last drawn in
+        };
+        struct Entry {
+            int slot; //-1 if the file is no image after all
+            int64_t mtime;
+        };
+
+        void run();
+        void decode(const Request &request, Decoded *decoded);
+        int takeSlot(SDL_Renderer *renderer);
+        void place(SDL_Renderer *renderer, Decoded *decoded);
+        void park(Decoded *decoded);
+        void dropEntry(const std::string &path);
+
+        std::function<void()> wake;
+        std::vector<std::thread> threads;
+        bool persist;
+
+        std::mutex lock; //everything down to the main thread part
+        std::condition_variable work_ready;
+        std::deque<Request> queue; //newest first
+        std::unordered_map<std::string, unsigned> wanted; //queued or decoding -> frame last drawn
+        std::vector<Decoded *> ready;
+        int decoding;
+        unsigned frame;
+        bool quitting;
+
+        //main thread only
+        ResourcePool *pool;
+        std::unordered_map<std::string, Entry> entries;
+        std::vector<TextureHandle> pages;
+        std::vector<Slot> slots;
+        std::vector<int> free_slots;
+        std::unordered_map<std::string, Parked> parked; //decoded, no cell free yet
+        int placed; //uploads this frame
+};
+
+#endif
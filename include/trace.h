@@ -0,0 +1,69 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <stdint.h>
+
+//INSTRUMENTATION, built with TRACE=1 (-DUSE_TRACE). without it the macros
+//below are empty and the functions inline no-ops, nothing is left behind.
+//
+//TRACE_SCOPE("name") times the rest of the enclosing block, on any thread.
+//every timed scope is kept for a Chrome trace (chrome://tracing, Perfetto)
+//written by traceWrite(); the main thread sums them up per frame for the
+//overlay. TRACE_COUNT(counter, n) adds to one of the per-frame counters.
+
+enum TraceCounter {
+    TRACE_SYSCALLS,   //filesystem calls: open, getdents64, stat, io_uring_enter...
+    TRACE_TEXTURES,   //textures created
+    TRACE_DRAW_CALLS, //SDL_RenderCopy, SDL_RenderGeometry, SDL_RenderFillRect...
+    TRACE_COUNTERS
+};
+
+#define TRACE_FRAME_SCOPES 12 //distinct scope names summed per frame
+#define TRACE_MAX_EVENTS (1u << 20) //scopes kept for the trace file, later ones are dropped
+
+//what the frame traceFrame() just closed cost
+struct TraceFrame {
+    uint64_t counters[TRACE_COUNTERS];
+    int scopes;
+    const char *scope_names[TRACE_FRAME_SCOPES];
+    double scope_ms[TRACE_FRAME_SCOPES]; //all threads, ended during the frame
+    double worst_ms[TRACE_FRAME_SCOPES]; //longest single one of them
+};
+
+#ifdef USE_TRACE
+
+class TraceScope {
+    public:
+        explicit TraceScope(const char *name);
+        ~TraceScope();
+
+    private:
+        const char *name;
+        int64_t start;
+};
+
+void traceCount(TraceCounter counter, uint64_t n);
+//main thread, once per frame: hands out the frame that ended and starts the next
+void traceFrame(TraceFrame *frame);
+//every scope so far plus the per-frame counters as Chrome trace JSON
+bool traceWrite(const std::string &file);
+inline bool traceBuilt() { return true; }
+
+#define TRACE_JOIN2(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN2(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_JOIN(trace_scope_, __LINE__)(name)
+#define TRACE_COUNT(counter, n) traceCount(counter, n)
+
+#else
+
+inline void traceFrame(TraceFrame *frame) { frame->scopes = 0; }
+inline bool traceWrite(const std::string &file) { return false; }
+inline bool traceBuilt() { return false; }
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_COUNT(counter, n) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef TREEWALKER_H
+#define TREEWALKER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "entrystore.h"
+#include "namefilter.h"
+
+#define TREE_QUEUED_MAX 4096 //folders waiting in the queues, past this a thread reads its own subfolders itself
+
+//one folder of an expanded tree. entries link down to their nodes with
+//EntryStore::child, a node links back up with parent. a child's index is
+//always larger than its parent's.
+struct TreeNode {
+    std::string path;
+    int parent;       //-1 for the root
+    int parent_entry; //which entry of the parent this folder is, see linkChildren
+    int depth;        //0 for the root
+    bool loaded;      //false for a placeholder whose folder is still being read
+    bool expanded;    //its rows show under its parent entry
+    EntryStore entries;
+
+    //row layout, kept by listview
+    std::vector<int> row_sums; //Fenwick tree over the entries, 1-based
+    int row_count;             //rows of the entries and their expanded children
+
+    //filter, kept by listview
+    NameIndex index;
+    std::vector<unsigned char> shown; //1 for entries matching it, empty when there is none
+
+    TreeNode() : parent(-1), parent_entry(-1), depth(0), loaded(false), expanded(false), row_count(0) {}
+};
+
+struct TreeProgress {
+    size_t folders;      //read so far
+    size_t folders_left; //found but not read yet
+    size_t entries;
+    bool done;
+};
+
+//expands a whole folder tree on a pool of threads. every thread works from
+//the back of its own queue and steals from the front of the others' when it
+//runs dry, so one huge subtree gets spread over the pool. nodes are handed
+//to the main thread as soon as they are read, in no particular order.
+//once TREE_QUEUED_MAX folders are queued a thread goes depth first through
+//the subfolders it found instead of queueing them, so a wide tree holds a
+//bounded queue plus the folders on the path being read, not its whole
+//frontier.
+class TreeWalker {
+    public:
+        //wake is called from a pool thread when finished nodes are waiting.
+        //threads 0 picks one per core (at least 2, the work is mostly waiting).
+        explicit TreeWalker(std::function<void()> wake, unsigned threads = 0);
+        ~TreeWalker();
+
+        //cancels the walk in progress (if any) and expands path. folders deeper
+        //than max_depth levels below it are listed but not opened. returns the
+        //generation its nodes will carry.
+        unsigned start(const std::string &path, int max_depth, const SortOrder &order);
+        //drops the walk in progress and every folder still queued by open().
+        //nodes are numbered from 1 again after it, for a new tree.
+        void cancel();
+        //reads just one more folder, next to whatever walk is running. its
+        //index in the tree is picked here (so it cannot collide with a walk's)
+        //and stored in node. returns the generation it will carry.
+        unsigned open(const std::string &path, int parent, int depth, const SortOrder &order, int *node);
+
+        //main thread only. hands over the nodes finished since the last call
+        //with their index in the tree, caller owns (and deletes) them.
+        struct Result {
+            int index;
+            unsigned generation;
+            TreeNode *node;
+        };
+        bool poll(std::vector<Result> *results);
+
+        TreeProgress progress();
+        //at most nodes finished nodes wait for poll(), pool threads hold on to
+        //theirs until there is room. 0 (the default) is no limit.
+        void setBacklog(size_t nodes);
+
+    private:
+        struct Task {
+            std::string path;
+            int node;
+            int parent;
+            int depth;
+            int max_depth;
+            SortOrder order;
+            unsigned generation;
+        };
+        struct TaskQueue {
+            std::mutex lock;
+            std::deque<Task> tasks;
+        };
+
+        void run(unsigned self);
+        void push(unsigned self, const Task &task);
+        bool take(unsigned self, Task *task);
+        void expand(unsigned self, const Task &task);
+
+        std::function<void()> wake;
+        std::vector<TaskQueue *> queues;
+        std::vector<std::thread> threads;
+        std::atomic<unsigned> generation;
+        std::atomic<int> next_node;
+        std::atomic<long> queued;   //tasks sitting in the queues, any generation
+        std::mutex idle_lock;
+        std::condition_variable idle_wakeup;
+        bool quitting;
+
+        //finished nodes and the counters of the current generation
+        std::mutex done_lock;
+        std::vector<Result> finished;
+        size_t backlog;
+        std::condition_variable drained; //poll() made room, or the walk was cancelled
+        size_t folders;
+        size_t folders_left;
+        size_t entries;
+};
+
+#endif
@@ -0,0 +1,462 @@
+#include "asyncstat.h"
+#include "trace.h"
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef USE_IO_URING
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#ifndef IORING_TIMEOUT_ETIME_SUCCESS
+#define IORING_TIMEOUT_ETIME_SUCCESS (1U << 5) //older kernels refuse it, the delayed stats then run synchronously
+#endif
+#endif
+
+#define ASYNC_MIN_JOBS 32     //below this the setup cost is not worth it
+#define STAT_THREAD_COUNT 32  //latency bound, not cpu bound, so more than the core count
+#define JOBS_PER_THREAD 16    //a batch wakes one pool thread per this many jobs
+#define URING_DEPTH 256       //requests kept in flight
+#define URING_DELAY_MARK (~0ull) //user_data of the timeouts setStatDelay puts before each statx
+
+static std::atomic<bool> statx_missing(false);
+static std::atomic<unsigned> stat_delay_us(0);
+#ifdef USE_IO_URING
+static std::atomic<StatBackend> backend(STAT_URING);
+#else
+static std::atomic<StatBackend> backend(STAT_THREADS);
+#endif
+
+void setStatBackend(StatBackend b){
+#ifndef USE_IO_URING
+    if(b == STAT_URING){
+        b = STAT_THREADS;
+    }
+#endif
+    backend.store(b);
+}
+
+StatBackend statBackend(){
+    return backend.load();
+}
+
+void setStatDelay(unsigned microseconds){
+    stat_delay_us.store(microseconds);
+}
+
+bool statAt(int dirfd, const char *name, bool follow, uint64_t *size, mode_t *mode, int64_t *mtime){
+    TRACE_COUNT(TRACE_SYSCALLS, 1);
+#ifdef STATX_SIZE
+    if(!statx_missing.load(std::memory_order_relaxed)){
+        struct statx stx;
+        int flags = AT_STATX_DONT_SYNC | (follow ? 0 : AT_SYMLINK_NOFOLLOW);
+        if(statx(dirfd, name, flags, STATX_SIZE | STATX_MODE | STATX_MTIME, &stx) == 0){
+            *size = stx.stx_size;
+            *mode = stx.stx_mode;
+            *mtime = stx.stx_mtime.tv_sec;
+            return true;
+        }
+        if(errno != ENOSYS){
+            return false;
+        }
+        statx_missing.store(true, std::memory_order_relaxed); //old kernel, use fstatat from now on
+    }
+#endif
+    struct stat filestats;
+    if(fstatat(dirfd, name, &filestats, follow ? 0 : AT_SYMLINK_NOFOLLOW) != 0){
+        return false;
+    }
+    *size = filestats.st_size;
+    *mode = filestats.st_mode;
+    *mtime = filestats.st_mtime;
+    return true;
+}
+
+static void runJob(int dirfd, StatJob *job){
+    unsigned delay = stat_delay_us.load(std::memory_order_relaxed);
+    if(delay > 0){
+        std::this_thread::sleep_for(std::chrono::microseconds(delay));
+    }
+    job->ok = statAt(dirfd, job->name, job->follow, &job->size, &job->mode, &job->mtime);
+}
+
+static void statJobsSync(int dirfd, std::vector<StatJob> *jobs){
+    for(int i = 0; i < jobs->size(); i++){
+        runJob(dirfd, &(*jobs)[i]);
+    }
+}
+
+//one statJobs call handed to the pool
+struct StatBatch {
+    int dirfd;
+    std::vector<StatJob> *jobs;
+    std::atomic<size_t> next; //first job nobody took yet
+    size_t finished;          //jobs answered, under the pool lock
+    int helpers;              //pool threads still looking at the batch, under the pool lock
+};
+
+//threads shared by every caller (scan worker, tree walkers, folder sizer),
+//started on the first batch big enough to need them and kept until exit.
+//the caller works on its own batch too, pool threads join in.
+class StatPool {
+    public:
+        StatPool();
+        ~StatPool();
+        void run(int dirfd, std::vector<StatJob> *jobs);
+
+    private:
+        void work();
+        static size_t drain(StatBatch *batch);
+
+        std::mutex lock;
+        std::condition_variable ready;    //a batch was queued
+        std::condition_variable finished; //a batch got its last answer
+        std::deque<StatBatch *> queue;    //batches with jobs nobody took yet
+        bool quitting;
+        std::vector<std::thread> threads;
+};
+
+StatPool::StatPool() : quitting(false){
+    for(int i = 1; i < STAT_THREAD_COUNT; i++){
+        threads.push_back(std::thread(&StatPool::work, this));
+    }
+}
+
+StatPool::~StatPool(){
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        quitting = true;
+    }
+    ready.notify_all();
+    for(int i = 0; i < threads.size(); i++){
+        threads[i].join();
+    }
+}
+
+//answers jobs of the batch until none are left, returns how many
+size_t StatPool::drain(StatBatch *batch){
+    size_t total = batch->jobs->size();
+    size_t ran = 0;
+    size_t i;
+    while((i = batch->next.fetch_add(1, std::memory_order_relaxed)) < total){
+        runJob(batch->dirfd, &(*batch->jobs)[i]);
+        ran++;
+    }
+    return ran;
+}
+
+void StatPool::work(){
+    std::unique_lock<std::mutex> guard(lock);
+    while(true){
+        ready.wait(guard, [this]{ return quitting || !queue.empty(); });
+        if(quitting){
+            return;
+        }
+        StatBatch *batch = queue.front();
+        batch->helpers++; //keeps the caller from returning under us
+        guard.unlock();
+        size_t ran = drain(batch);
+        guard.lock();
+        std::deque<StatBatch *>::iterator it = std::find(queue.begin(), queue.end(), batch);
+        if(it != queue.end()){
+            queue.erase(it); //every job is taken
+        }
+        batch->finished += ran;
+        batch->helpers--;
+        if(batch->helpers == 0 && batch->finished == batch->jobs->size()){
+            finished.notify_all();
+        }
+    }
+}
+
+void StatPool::run(int dirfd, std::vector<StatJob> *jobs){
+    StatBatch batch;
+    batch.dirfd = dirfd;
+    batch.jobs = jobs;
+    batch.next.store(0);
+    batch.finished = 0;
+    batch.helpers = 0;
+    size_t wanted = std::min(jobs->size() / JOBS_PER_THREAD, threads.size());
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        queue.push_back(&batch);
+    }
+    for(size_t i = 0; i < wanted; i++){
+        ready.notify_one();
+    }
+
+    size_t ran = drain(&batch);
+    std::unique_lock<std::mutex> guard(lock);
+    std::deque<StatBatch *>::iterator it = std::find(queue.begin(), queue.end(), &batch);
+    if(it != queue.end()){
+        queue.erase(it);
+    }
+    batch.finished += ran;
+    finished.wait(guard, [&]{ return batch.helpers == 0 && batch.finished == jobs->size(); });
+}
+
+static void statJobsThreaded(int dirfd, std::vector<StatJob> *jobs){
+    static StatPool pool; //first use starts the threads
+    pool.run(dirfd, jobs);
+}
+
+#ifdef USE_IO_URING
+
+//minimal raw-syscall ring, liburing is not a dependency of this project
+struct StatRing {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_len, cq_len, sqes_len;
+};
+
+static bool openRing(StatRing *ring, unsigned depth){
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = syscall(__NR_io_uring_setup, depth, &params);
+    if(ring->fd < 0){
+        return false;
+    }
+
+    ring->sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if(single && ring->cq_len > ring->sq_len){
+        ring->sq_len = ring->cq_len;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if(ring->sq_ptr == MAP_FAILED){
+        close(ring->fd);
+        return false;
+    }
+    ring->cq_ptr = ring->sq_ptr;
+    if(!single){
+        ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if(ring->cq_ptr == MAP_FAILED){
+            munmap(ring->sq_ptr, ring->sq_len);
+            close(ring->fd);
+            return false;
+        }
+    }
+    ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe *)mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if(ring->sqes == MAP_FAILED){
+        if(!single){
+            munmap(ring->cq_ptr, ring->cq_len);
+        }
+        munmap(ring->sq_ptr, ring->sq_len);
+        close(ring->fd);
+        return false;
+    }
+
+    char *sq = (char *)ring->sq_ptr;
+    char *cq = (char *)ring->cq_ptr;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return true;
+}
+
+static void closeRing(StatRing *ring){
+    munmap(ring->sqes, ring->sqes_len);
+    if(ring->cq_ptr != ring->sq_ptr){
+        munmap(ring->cq_ptr, ring->cq_len);
+    }
+    munmap(ring->sq_ptr, ring->sq_len);
+    close(ring->fd);
+}
+
+//what the kernel reads and writes while requests are in flight. on the heap
+//so it can outlive the call if the ring breaks before they all complete
+struct UringBuffers {
+    struct __kernel_timespec delay;
+    std::vector<struct statx> results;
+};
+
+//returns false only if the ring could not be used at all, so the caller can fall back
+static bool statJobsUring(int dirfd, std::vector<StatJob> *jobs){
+    StatRing ring;
+    if(!openRing(&ring, URING_DEPTH)){
+        return false;
+    }
+
+    //a set delay is a timeout linked in front of each statx, so the waits
+    //overlap in the kernel like slow answers from a real mount would
+    unsigned delay_us = stat_delay_us.load();
+    bool delayed = delay_us > 0;
+    unsigned slots = delayed ? URING_DEPTH / 2 : URING_DEPTH;
+    UringBuffers *buffers = new UringBuffers;
+    buffers->delay.tv_sec = delay_us / 1000000;
+    buffers->delay.tv_nsec = (long long)(delay_us % 1000000) * 1000;
+    buffers->results.resize(slots);
+    std::vector<struct statx> &results = buffers->results;
+
+    size_t total = jobs->size();
+    std::vector<size_t> slot_job(slots);
+    std::vector<unsigned> free_slots;
+    for(unsigned i = 0; i < slots; i++){
+        free_slots.push_back(i);
+    }
+
+    //every request the kernel took (delays included) posts one completion
+    unsigned first_head = *ring.sq_head;
+    size_t completions = 0;
+    size_t next = 0;
+    size_t done = 0;
+    auto reap = [&]{
+        unsigned head = *ring.cq_head;
+        while(head != __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE)){
+            struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+            completions++;
+            head++;
+            if(cqe->user_data == URING_DELAY_MARK){
+                continue;
+            }
+            unsigned slot = cqe->user_data;
+            StatJob *job = &(*jobs)[slot_job[slot]];
+            if(cqe->res == 0){
+                job->ok = true;
+                job->size = results[slot].stx_size;
+                job->mode = results[slot].stx_mode;
+                job->mtime = results[slot].stx_mtime.tv_sec;
+            } else if(cqe->res == -EINVAL || cqe->res == -EOPNOTSUPP || cqe->res == -ECANCELED){
+                runJob(dirfd, job); //kernel without IORING_OP_STATX, or one that broke the delay link
+            } else {
+                job->ok = false;
+            }
+            free_slots.push_back(slot);
+            done++;
+        }
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    };
+    auto taken = [&]{
+        return (size_t)(__atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE) - first_head);
+    };
+
+    bool broken = false;
+    unsigned tail = *ring.sq_tail;
+    while(done < total){
+        //queue as many requests as there are free result slots
+        while(next < total && !free_slots.empty()){
+            unsigned slot = free_slots.back();
+            free_slots.pop_back();
+            slot_job[slot] = next;
+
+            StatJob *job = &(*jobs)[next];
+            unsigned index;
+            struct io_uring_sqe *sqe;
+            if(delayed){
+                index = tail & *ring.sq_mask;
+                sqe = &ring.sqes[index];
+                memset(sqe, 0, sizeof(*sqe));
+                sqe->opcode = IORING_OP_TIMEOUT;
+                sqe->addr = (uint64_t)(uintptr_t)&buffers->delay;
+                sqe->len = 1;
+                sqe->timeout_flags = IORING_TIMEOUT_ETIME_SUCCESS;
+                sqe->flags = IOSQE_IO_LINK;
+                sqe->user_data = URING_DELAY_MARK;
+                ring.sq_array[index] = index;
+                tail++;
+            }
+            index = tail & *ring.sq_mask;
+            sqe = &ring.sqes[index];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_STATX;
+            sqe->fd = dirfd;
+            sqe->addr = (uint64_t)(uintptr_t)job->name;
+            sqe->len = STATX_SIZE | STATX_MODE | STATX_MTIME;
+            sqe->off = (uint64_t)(uintptr_t)&results[slot];
+            sqe->statx_flags = AT_STATX_DONT_SYNC | (job->follow ? 0 : AT_SYMLINK_NOFOLLOW);
+            sqe->user_data = slot;
+            ring.sq_array[index] = index;
+            tail++;
+            next++;
+        }
+        __atomic_store_n(ring.sq_tail, tail, __ATOMIC_RELEASE);
+
+        //an interrupted or partial submit leaves requests queued, pass them again
+        unsigned queued = tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+        int entered = syscall(__NR_io_uring_enter, ring.fd, queued, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        TRACE_COUNT(TRACE_SYSCALLS, 1);
+        if(entered < 0 && errno != EINTR){
+            broken = true; //whatever is left gets done synchronously below
+            break;
+        }
+        reap();
+    }
+
+    //the kernel may still write results of requests it took, wait for them
+    //before the buffers go away. requests it never took die with the ring
+    bool drained = true;
+    if(broken){
+        reap();
+        while(completions < taken()){
+            int entered = syscall(__NR_io_uring_enter, ring.fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+            TRACE_COUNT(TRACE_SYSCALLS, 1);
+            if(entered < 0 && errno != EINTR){
+                drained = false;
+                break;
+            }
+            reap();
+        }
+    }
+    closeRing(&ring);
+    if(drained){
+        delete buffers;
+    } //else leaked on purpose: closing the ring does not wait for what is in flight
+
+    if(done < total){
+        //ring broke mid-way, redo everything unfinished
+        for(size_t i = 0; i < total; i++){
+            StatJob *job = &(*jobs)[i];
+            if(!job->ok){
+                runJob(dirfd, job);
+            }
+        }
+    }
+    return true;
+}
+
+#endif
+
+void statJobs(int dirfd, std::vector<StatJob> *jobs){
+    for(int i = 0; i < jobs->size(); i++){
+        (*jobs)[i].ok = false;
+    }
+
+    StatBackend use = backend.load();
+    if(jobs->size() < ASYNC_MIN_JOBS || use == STAT_SYNC){
+        statJobsSync(dirfd, jobs);
+        return;
+    }
+#ifdef USE_IO_URING
+    if(use == STAT_URING){
+        if(statJobsUring(dirfd, jobs)){
+            return;
+        }
+        //io_uring disabled or blocked (seccomp, old kernel). a backend set
+        //meanwhile on another thread is kept
+        backend.compare_exchange_strong(use, STAT_THREADS);
+    }
+#endif
+    statJobsThreaded(dirfd, jobs);
+}
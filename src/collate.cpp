@@ -0,0 +1,37 @@
+#include <ctype.h>
+#include "collate.h"
+
+size_t appendCollationKey(std::vector<unsigned char> *keys, const char *name, size_t len, bool natural){
+    //a one digit run grows to three bytes, so room for 3 * len always fits
+    size_t start = keys->size();
+    keys->resize(start + (natural ? 3 * len : len));
+    unsigned char *out = &(*keys)[0] + start;
+    unsigned char *p = out;
+    size_t i = 0;
+    while(i < len){
+        unsigned char c = name[i];
+        if(natural && isdigit(c)){
+            size_t end = i;
+            while(end < len && isdigit((unsigned char)name[end])){
+                end++;
+            }
+            //leading zeros do not change the value, but keep one digit of "000"
+            while(i + 1 < end && name[i] == '0'){
+                i++;
+            }
+            //the marker sits where a digit would against letters and punctuation.
+            //a literal '0' never reaches the key outside a run, so both keys are
+            //always at the same marker when this byte matches.
+            *p++ = '0';
+            *p++ = end - i; //names are at most 255 bytes
+            while(i < end){
+                *p++ = name[i++];
+            }
+        } else {
+            *p++ = tolower(c);
+            i++;
+        }
+    }
+    keys->resize(start + (p - out));
+    return p - out;
+}
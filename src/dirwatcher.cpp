@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include "dirwatcher.h"
+
+#define WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY | IN_ATTRIB \
+                    | IN_CLOSE_WRITE | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK)
+#define EVENT_BUFFER_SIZE (64 * 1024)
+
+DirWatcher::DirWatcher(std::function<void()> wake_fn)
+    : wake(wake_fn), generation(0), lost_events(false)
+{
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(pipe2(wake_pipe, O_CLOEXEC | O_NONBLOCK) != 0){
+        wake_pipe[0] = wake_pipe[1] = -1;
+    }
+    if(inotify_fd < 0){
+        std::cerr << "inotify unavailable, folders will not refresh\n";
+        return;
+    }
+    thread = std::thread(&DirWatcher::run, this);
+}
+
+DirWatcher::~DirWatcher(){
+    if(thread.joinable()){
+        char quit = 'q';
+        if(write(wake_pipe[1], &quit, 1) < 0){
+            //pipe full means a wakeup is pending anyway
+        }
+        thread.join();
+    }
+    if(inotify_fd >= 0){
+        close(inotify_fd);
+    }
+    if(wake_pipe[0] >= 0){
+        close(wake_pipe[0]);
+        close(wake_pipe[1]);
+    }
+}
+
+void DirWatcher::watch(int node, const std::string &path){
+    if(inotify_fd < 0){
+        return;
+    }
+    int wd = inotify_add_watch(inotify_fd, path.c_str(), WATCH_MASK);
+    if(wd < 0){
+        static bool warned = false;
+        if(errno == ENOSPC && !warned){
+            std::cerr << "out of inotify watches (fs.inotify.max_user_watches), some folders will not refresh\n";
+            warned = true;
+        }
+        return;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    //the same folder under two nodes (or twice) shares one descriptor, the newest wins
+    Watch w;
+    w.node = node;
+    w.path = path;
+    w.generation = generation;
+    std::map<int, Watch>::iterator old = watches.find(wd);
+    if(old != watches.end()){
+        node_watch.erase(old->second.node);
+    }
+    watches[wd] = w;
+    node_watch[node] = wd;
+}
+
+void DirWatcher::unwatch(int node){
+    std::lock_guard<std::mutex> guard(lock);
+    std::map<int, int>::iterator it = node_watch.find(node);
+    if(it == node_watch.end()){
+        return;
+    }
+    inotify_rm_watch(inotify_fd, it->second);
+    watches.erase(it->second);
+    node_watch.erase(it);
+}
+
+unsigned DirWatcher::clear(){
+    std::lock_guard<std::mutex> guard(lock);
+    for(std::map<int, Watch>::iterator it = watches.begin(); it != watches.end(); ++it){
+        inotify_rm_watch(inotify_fd, it->first);
+    }
+    watches.clear();
+    node_watch.clear();
+    ready.clear();
+    return ++generation;
+}
+
+bool DirWatcher::poll(std::vector<FolderChanges> *changes){
+    std::lock_guard<std::mutex> guard(lock);
+    changes->clear();
+    changes->swap(ready);
+    return !changes->empty();
+}
+
+//stats every pending name (or relists overflowed folders) and hands the result over
+void DirWatcher::flush(){
+    std::vector<FolderChanges> batch;
+    for(std::map<int, std::set<std::string> >::iterator it = pending.begin(); it != pending.end(); ++it){
+        Watch w;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            std::map<int, Watch>::iterator found = watches.find(it->first);
+            if(found == watches.end()){
+                continue; //unwatched meanwhile
+            }
+            w = found->second;
+        }
+
+        FolderChanges changes;
+        changes.node = w.node;
+        changes.generation = w.generation;
+        changes.relist = lost_events || overflowed.count(it->first) != 0;
+        if(changes.relist){
+            scanDirectory(w.path, &changes.entries);
+        } else {
+            int dirfd = open(w.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if(dirfd < 0){
+                continue; //the folder itself is gone, its parent reports that
+            }
+            for(std::set<std::string>::iterator name = it->second.begin(); name != it->second.end(); ++name){
+                changes.names.push_back(*name);
+                ScanEntry entry;
+                if(scanEntryAt(dirfd, name->c_str(), &entry)){
+                    changes.entries.push_back(entry);
+                }
+            }
+            close(dirfd);
+        }
+        batch.push_back(changes);
+    }
+    pending.clear();
+    overflowed.clear();
+    lost_events = false;
+
+    bool first;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        first = ready.empty();
+        for(int i = 0; i < batch.size(); i++){
+            if(batch[i].generation == generation){
+                ready.push_back(batch[i]);
+            }
+        }
+        first = first && !ready.empty();
+    }
+    if(first){
+        wake();
+    }
+}
+
+void DirWatcher::run(){
+    typedef std::chrono::steady_clock Clock;
+    char *buffer = new char[EVENT_BUFFER_SIZE];
+    Clock::time_point first_event, last_event;
+
+    while(true){
+        int timeout = -1;
+        if(!pending.empty()){
+            Clock::time_point now = Clock::now();
+            long quiet = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_event).count();
+            long held = std::chrono::duration_cast<std::chrono::milliseconds>(now - first_event).count();
+            timeout = std::max(0L, std::min(WATCH_SETTLE_MS - quiet, WATCH_MAX_DELAY_MS - held));
+        }
+
+        struct pollfd fds[2];
+        fds[0].fd = inotify_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = wake_pipe[0];
+        fds[1].events = POLLIN;
+        int ready_fds = ::poll(fds, 2, timeout);
+        if(ready_fds < 0 && errno != EINTR){
+            break;
+        }
+        if(fds[1].revents & POLLIN){
+            break; //quitting
+        }
+
+        if(fds[0].revents & POLLIN){
+            long got;
+            while((got = read(inotify_fd, buffer, EVENT_BUFFER_SIZE)) > 0){
+                if(pending.empty()){
+                    first_event = Clock::now();
+                }
+                last_event = Clock::now();
+                for(long pos = 0; pos < got; ){
+                    struct inotify_event *event = (struct inotify_event *)(buffer + pos);
+                    pos += sizeof(struct inotify_event) + event->len;
+                    if(event->mask & IN_Q_OVERFLOW){
+                        //the kernel dropped events, every watched folder gets relisted
+                        lost_events = true;
+                        std::lock_guard<std::mutex> guard(lock);
+                        for(std::map<int, Watch>::iterator it = watches.begin(); it != watches.end(); ++it){
+                            pending[it->first];
+                        }
+                        continue;
+                    }
+                    if(event->len == 0){
+                        continue; //about the folder itself, its parent sees the same thing by name
+                    }
+                    if(overflowed.count(event->wd) != 0){
+                        continue; //read whole anyway
+                    }
+                    std::set<std::string> &names = pending[event->wd];
+                    names.insert(event->name);
+                    if(names.size() > WATCH_RELIST_NAMES){
+                        overflowed.insert(event->wd);
+                        names.clear();
+                    }
+                }
+            }
+        }
+
+        if(!pending.empty()){
+            Clock::time_point now = Clock::now();
+            if(now - last_event >= std::chrono::milliseconds(WATCH_SETTLE_MS)
+               || now - first_event >= std::chrono::milliseconds(WATCH_MAX_DELAY_MS)){
+                flush();
+            }
+        }
+    }
+    delete[] buffer;
+}
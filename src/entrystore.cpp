@@ -0,0 +1,510 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <unordered_set>
+#include <unordered_map>
+#include <string.h>
+#include "entrystore.h"
+#include "trace.h"
+
+#define PARALLEL_SORT_MIN 65536   //below this one thread sorts faster than several start
+#define PARALLEL_SORT_THREADS 8
+#define MERGE_SEARCH_RATIO 64     //fewer new entries than 1 in this many are placed by binary search
+
+//where one entry goes in a sort. everything that decides the order before
+//the rest of the name is packed into integers, so most comparisons never
+//leave the record array.
+struct EntryStore::SortRecord {
+    uint64_t primary;  //size, mtime or type, already flipped for descending
+    uint64_t prefix;   //8 bytes of the collation key, big endian, zero padded
+    uint32_t index;
+    uint16_t group;    //0 for folders kept on top, 1 for everything else
+    uint16_t key_left; //key bytes past the ones in prefix
+};
+
+//orders records by what they hold, without touching the key arena. on a tied
+//prefix a key that ends there is the shorter one and goes first. two that end
+//are equal (keys never contain a zero byte) and fall back to the raw names;
+//two that go on are put in index order and refined later.
+class EntryStore::PrefixLess {
+    public:
+        PrefixLess(const EntryStore *store, bool names_descending)
+            : store(store), names_descending(names_descending) {}
+
+        bool operator()(const SortRecord &a, const SortRecord &b) const {
+            if(a.group != b.group){
+                return a.group < b.group;
+            }
+            if(a.primary != b.primary){
+                return a.primary < b.primary;
+            }
+            if(a.prefix != b.prefix){
+                return names_descending ? a.prefix > b.prefix : a.prefix < b.prefix;
+            }
+            if((a.key_left == 0) != (b.key_left == 0)){
+                return names_descending ? b.key_left == 0 : a.key_left == 0;
+            }
+            if(a.key_left == 0){
+                int cmp = strcmp(store->name(a.index), store->name(b.index));
+                if(cmp != 0){
+                    return names_descending ? cmp > 0 : cmp < 0;
+                }
+            }
+            return a.index < b.index;
+        }
+
+    private:
+        const EntryStore *store;
+        bool names_descending;
+};
+
+//full comparison, for merging two sorted runs where each record is looked at
+//about once and refining would not pay off
+class EntryStore::RecordLess {
+    public:
+        RecordLess(const EntryStore *store, bool names_descending)
+            : store(store), names_descending(names_descending) {}
+
+        bool operator()(const SortRecord &a, const SortRecord &b) const {
+            if(a.group != b.group){
+                return a.group < b.group;
+            }
+            if(a.primary != b.primary){
+                return a.primary < b.primary;
+            }
+            int names = a.prefix != b.prefix ? (a.prefix < b.prefix ? -1 : 1) : store->compareKeys(a.index, b.index);
+            if(names != 0){
+                return names_descending ? names > 0 : names < 0;
+            }
+            return a.index < b.index;
+        }
+
+    private:
+        const EntryStore *store;
+        bool names_descending;
+};
+
+void EntryStore::clear(){
+    names.clear();
+    name_offsets.clear();
+    name_lengths.clear();
+    types.clear();
+    modes.clear();
+    sizes.clear();
+    mtimes.clear();
+    links.clear();
+    children.clear();
+    keys.clear();
+    key_offsets.clear();
+    key_lengths.clear();
+    changes = 0;
+}
+
+void EntryStore::reserve(size_t entries, size_t name_bytes){
+    names.reserve(name_bytes);
+    name_offsets.reserve(entries);
+    name_lengths.reserve(entries);
+    types.reserve(entries);
+    modes.reserve(entries);
+    sizes.reserve(entries);
+    mtimes.reserve(entries);
+    links.reserve(entries);
+    children.reserve(entries);
+}
+
+void EntryStore::add(const char *name, size_t len, FileType type, mode_t mode, uint64_t bytes, int64_t mtime, bool is_link){
+    if(len > 255){
+        len = 255;
+    }
+    name_offsets.push_back(names.size());
+    names.insert(names.end(), name, name + len);
+    names.push_back('\0');
+    name_lengths.push_back(len);
+    types.push_back(type);
+    modes.push_back(mode);
+    sizes.push_back(bytes);
+    mtimes.push_back(mtime);
+    links.push_back(is_link);
+    children.push_back(-1);
+    changes = 0;
+}
+
+//keys entries added since the last sort, or all of them if the natural flag changed
+void EntryStore::updateKeys(){
+    if(keys_natural != order.natural){
+        keys.clear();
+        key_offsets.clear();
+        key_lengths.clear();
+        keys_natural = order.natural;
+    }
+    if(key_offsets.empty()){
+        keys.reserve(names.size());
+    }
+    for(size_t i = key_offsets.size(); i < size(); i++){
+        key_offsets.push_back(keys.size());
+        key_lengths.push_back(appendCollationKey(&keys, name(i), nameLength(i), keys_natural));
+    }
+}
+
+//loads the 8 key bytes starting at depth into the record
+void EntryStore::loadPrefix(SortRecord *record, size_t depth) const {
+    const unsigned char *key = &keys[key_offsets[record->index]];
+    size_t len = key_lengths[record->index];
+    record->prefix = 0;
+    for(size_t b = depth; b < depth + 8; b++){
+        record->prefix = (record->prefix << 8) | (b < len ? key[b] : 0);
+    }
+    record->key_left = len > depth + 8 ? len - depth - 8 : 0;
+}
+
+//memcmp order of the two keys, shorter first, raw names when the keys match
+//("Readme" and "README")
+int EntryStore::compareKeys(uint32_t a, uint32_t b) const {
+    size_t a_len = key_lengths[a];
+    size_t b_len = key_lengths[b];
+    int cmp = memcmp(&keys[key_offsets[a]], &keys[key_offsets[b]], std::min(a_len, b_len));
+    if(cmp != 0){
+        return cmp;
+    }
+    if(a_len != b_len){
+        return a_len < b_len ? -1 : 1;
+    }
+    return strcmp(name(a), name(b));
+}
+
+//the record of entry i for the current order, prefix at the start of the key
+void EntryStore::makeRecord(size_t i, SortRecord *record) const {
+    record->index = i;
+    loadPrefix(record, 0);
+
+    bool is_dir = (types[i] == TYPE_DIRECTORY);
+    record->group = (order.key != SORT_NAME && is_dir) ? 0 : 1;
+    switch(order.key){
+        case SORT_SIZE:
+            record->primary = is_dir ? 0 : sizes[i];
+            break;
+        case SORT_MTIME:
+            record->primary = is_dir ? 0 : (uint64_t)mtimes[i] ^ (1ull << 63); //signed to unsigned order
+            break;
+        case SORT_TYPE:
+            record->primary = types[i] & 0x0f;
+            break;
+        default:
+            record->primary = 0;
+            break;
+    }
+    if(order.descending && order.key != SORT_NAME){
+        record->primary = ~record->primary;
+    }
+}
+
+void EntryStore::makeRecords(std::vector<SortRecord> *records) const {
+    records->resize(size());
+    for(size_t i = 0; i < size(); i++){
+        makeRecord(i, &(*records)[i]);
+    }
+}
+
+//sorts equal slices on their own threads, then merges neighbouring runs pairwise
+template<typename T, typename Less>
+static void parallelSort(std::vector<T> *items, const Less &less){
+    size_t n = items->size();
+    unsigned threads = std::min(std::thread::hardware_concurrency(), (unsigned)PARALLEL_SORT_THREADS);
+    if(n < PARALLEL_SORT_MIN || threads < 2){
+        std::sort(items->begin(), items->end(), less);
+        return;
+    }
+
+    typename std::vector<T>::iterator begin = items->begin();
+    std::vector<size_t> bounds;
+    for(unsigned t = 0; t <= threads; t++){
+        bounds.push_back(n * t / threads);
+    }
+    std::vector<std::thread> pool;
+    for(unsigned t = 0; t < threads; t++){
+        pool.push_back(std::thread([&, t]{ std::sort(begin + bounds[t], begin + bounds[t + 1], less); }));
+    }
+    for(int t = 0; t < pool.size(); t++){
+        pool[t].join();
+    }
+
+    while(bounds.size() > 2){
+        size_t runs = bounds.size() - 1;
+        std::vector<size_t> merged;
+        pool.clear();
+        for(size_t r = 0; r < runs; r += 2){
+            merged.push_back(bounds[r]);
+            if(r + 1 < runs){
+                size_t lo = bounds[r], mid = bounds[r + 1], hi = bounds[r + 2];
+                pool.push_back(std::thread([=, &less]{ std::inplace_merge(begin + lo, begin + mid, begin + hi, less); }));
+            }
+        }
+        merged.push_back(n);
+        for(int t = 0; t < pool.size(); t++){
+            pool[t].join();
+        }
+        bounds.swap(merged);
+    }
+}
+
+//sorts each run of records tied on their prefix by the next 8 key bytes,
+//until every key is told apart or finished
+void EntryStore::refineTies(SortRecord *first, SortRecord *last, size_t depth, const PrefixLess &less) const {
+    SortRecord *run = first;
+    while(run != last){
+        SortRecord *end = run + 1;
+        while(end != last && end->group == run->group && end->primary == run->primary && end->prefix == run->prefix
+              && (end->key_left == 0) == (run->key_left == 0)){
+            end++;
+        }
+        if(end - run > 1 && run->key_left > 0){
+            for(SortRecord *r = run; r != end; r++){
+                loadPrefix(r, depth + 8);
+            }
+            std::sort(run, end, less);
+            refineTies(run, end, depth + 8, less);
+        }
+        run = end;
+    }
+}
+
+//reorders every column except the name and key arenas, which only the offsets point into
+void EntryStore::permute(const std::vector<uint32_t> &from){
+    std::vector<uint32_t> new_offsets(from.size());
+    std::vector<uint8_t> new_lengths(from.size());
+    std::vector<uint8_t> new_types(from.size());
+    std::vector<uint32_t> new_modes(from.size());
+    std::vector<uint64_t> new_sizes(from.size());
+    std::vector<int64_t> new_mtimes(from.size());
+    std::vector<uint8_t> new_links(from.size());
+    std::vector<int32_t> new_children(from.size());
+    std::vector<uint32_t> new_key_offsets(from.size());
+    std::vector<uint16_t> new_key_lengths(from.size());
+    for(size_t i = 0; i < from.size(); i++){
+        uint32_t j = from[i];
+        new_offsets[i] = name_offsets[j];
+        new_lengths[i] = name_lengths[j];
+        new_types[i] = types[j];
+        new_modes[i] = modes[j];
+        new_sizes[i] = sizes[j];
+        new_mtimes[i] = mtimes[j];
+        new_links[i] = links[j];
+        new_children[i] = children[j];
+        new_key_offsets[i] = key_offsets[j];
+        new_key_lengths[i] = key_lengths[j];
+    }
+    name_offsets.swap(new_offsets);
+    name_lengths.swap(new_lengths);
+    types.swap(new_types);
+    modes.swap(new_modes);
+    sizes.swap(new_sizes);
+    mtimes.swap(new_mtimes);
+    links.swap(new_links);
+    children.swap(new_children);
+    key_offsets.swap(new_key_offsets);
+    key_lengths.swap(new_key_lengths);
+    changes = 0;
+}
+
+void EntryStore::sort(const SortOrder &new_order){
+    TRACE_SCOPE("sort");
+    order = new_order;
+    updateKeys();
+    std::vector<SortRecord> records;
+    makeRecords(&records);
+    PrefixLess less(this, order.descending && order.key == SORT_NAME);
+    parallelSort(&records, less);
+    if(!records.empty()){
+        refineTies(&records[0], &records[0] + records.size(), 0, less);
+    }
+
+    std::vector<uint32_t> from(records.size());
+    for(size_t i = 0; i < records.size(); i++){
+        from[i] = records[i].index;
+    }
+    permute(from);
+}
+
+void EntryStore::mergeSorted(EntryStore &other){
+    if(other.order != order){
+        other.sort(order);
+    }
+    if(empty()){
+        *this = std::move(other); //nothing to merge with, other is the result
+        other.clear();
+        changes = 0;
+        return;
+    }
+    updateKeys();
+
+    size_t old_size = size();
+    uint32_t shift = names.size();
+    names.insert(names.end(), other.names.begin(), other.names.end());
+    for(size_t i = 0; i < other.size(); i++){
+        name_offsets.push_back(other.name_offsets[i] + shift);
+    }
+    name_lengths.insert(name_lengths.end(), other.name_lengths.begin(), other.name_lengths.end());
+    types.insert(types.end(), other.types.begin(), other.types.end());
+    modes.insert(modes.end(), other.modes.begin(), other.modes.end());
+    sizes.insert(sizes.end(), other.sizes.begin(), other.sizes.end());
+    mtimes.insert(mtimes.end(), other.mtimes.begin(), other.mtimes.end());
+    links.insert(links.end(), other.links.begin(), other.links.end());
+    children.insert(children.end(), other.children.begin(), other.children.end());
+
+    //other's keys were built when it was sorted, take them along
+    if(other.keys_natural == keys_natural && other.key_offsets.size() == other.size()){
+        shift = keys.size();
+        keys.insert(keys.end(), other.keys.begin(), other.keys.end());
+        for(size_t i = 0; i < other.size(); i++){
+            key_offsets.push_back(other.key_offsets[i] + shift);
+        }
+        key_lengths.insert(key_lengths.end(), other.key_lengths.begin(), other.key_lengths.end());
+    }
+    other.clear();
+    updateKeys();
+    changes = 0;
+
+    size_t added = size() - old_size;
+    RecordLess less(this, order.descending && order.key == SORT_NAME);
+    SortRecord last, first;
+    if(added == 0){
+        return;
+    }
+    makeRecord(old_size - 1, &last);
+    makeRecord(old_size, &first);
+    if(less(last, first)){
+        return; //everything new goes after what was there, appending was the merge
+    }
+
+    std::vector<uint32_t> from;
+    from.reserve(size());
+    if(added * MERGE_SEARCH_RATIO < old_size){
+        //a few new entries: each one's place is searched for, only the
+        //records looked at are built
+        size_t taken = 0;
+        for(size_t i = old_size; i < size(); i++){
+            SortRecord record, probe;
+            makeRecord(i, &record);
+            size_t lo = taken, hi = old_size;
+            while(lo < hi){
+                size_t mid = lo + (hi - lo) / 2;
+                makeRecord(mid, &probe);
+                if(less(record, probe)){
+                    hi = mid;
+                } else {
+                    lo = mid + 1;
+                }
+            }
+            for(; taken < lo; taken++){
+                from.push_back(taken);
+            }
+            from.push_back(i);
+        }
+        for(; taken < old_size; taken++){
+            from.push_back(taken);
+        }
+    } else {
+        //both halves are sorted already, a linear merge of their records is enough
+        std::vector<SortRecord> records, merged(size());
+        makeRecords(&records);
+        std::merge(records.begin(), records.begin() + old_size, records.begin() + old_size, records.end(),
+                   merged.begin(), less);
+        for(size_t i = 0; i < merged.size(); i++){
+            from.push_back(merged[i].index);
+        }
+    }
+    permute(from);
+}
+
+//drops the bytes of entries permute() left out
+void EntryStore::compactArenas(){
+    std::vector<char> new_names;
+    new_names.reserve(names.size());
+    for(size_t i = 0; i < size(); i++){
+        uint32_t offset = new_names.size();
+        new_names.insert(new_names.end(), name(i), name(i) + nameLength(i) + 1);
+        name_offsets[i] = offset;
+    }
+    names.swap(new_names);
+
+    if(key_offsets.size() == size()){
+        std::vector<unsigned char> new_keys;
+        new_keys.reserve(keys.size());
+        for(size_t i = 0; i < size(); i++){
+            uint32_t offset = new_keys.size();
+            new_keys.insert(new_keys.end(), &keys[0] + key_offsets[i], &keys[0] + key_offsets[i] + key_lengths[i]);
+            key_offsets[i] = offset;
+        }
+        keys.swap(new_keys);
+    }
+}
+
+void EntryStore::update(const std::vector<std::string> &changed, bool all, EntryStore &fresh, std::vector<int> *dropped){
+    std::unordered_set<std::string> gone(changed.begin(), changed.end());
+    std::unordered_map<std::string, size_t> fresh_dirs; //only built once an opened folder is dropped
+    bool dirs_known = false;
+
+    //one pass over the folder, however many names changed
+    std::vector<uint32_t> from;
+    std::string key;
+    if(!all){
+        updateKeys();
+        from.reserve(size());
+    }
+    for(size_t i = 0; i < size(); i++){
+        if(!all){
+            key.assign(name(i), nameLength(i));
+            if(gone.count(key) == 0){
+                from.push_back(i);
+                continue;
+            }
+        }
+        if(children[i] >= 0){
+            if(!dirs_known){
+                for(size_t j = 0; j < fresh.size(); j++){
+                    if(fresh.type(j) == TYPE_DIRECTORY){
+                        fresh_dirs[std::string(fresh.name(j), fresh.nameLength(j))] = j;
+                    }
+                }
+                dirs_known = true;
+            }
+            key.assign(name(i), nameLength(i));
+            std::unordered_map<std::string, size_t>::iterator dir = fresh_dirs.find(key);
+            if(dir != fresh_dirs.end()){
+                fresh.setChild(dir->second, children[i]);
+            } else {
+                dropped->push_back(children[i]);
+            }
+        }
+    }
+    if(all){
+        clear(); //fresh is the whole folder, it is taken over as it is
+    } else if(from.size() != size()){
+        permute(from); //kept entries stay in order
+        compactArenas();
+    }
+    mergeSorted(fresh);
+}
+
+uint64_t EntryStore::version() const {
+    static std::atomic<uint64_t> next_version(1);
+    if(changes == 0){
+        changes = next_version++;
+    }
+    return changes;
+}
+
+size_t EntryStore::memoryUsage() const {
+    return names.capacity()
+         + name_offsets.capacity() * sizeof(uint32_t)
+         + name_lengths.capacity() * sizeof(uint8_t)
+         + types.capacity() * sizeof(uint8_t)
+         + modes.capacity() * sizeof(uint32_t)
+         + sizes.capacity() * sizeof(uint64_t)
+         + mtimes.capacity() * sizeof(int64_t)
+         + links.capacity() * sizeof(uint8_t)
+         + children.capacity() * sizeof(int32_t)
+         + keys.capacity()
+         + key_offsets.capacity() * sizeof(uint32_t)
+         + key_lengths.capacity() * sizeof(uint16_t);
+}
@@ -0,0 +1,99 @@
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+#include "filedata.h"
+#include "entrystore.h"
+#include "filetypes.h"
+#include "trace.h"
+
+void updateFileList(EntryStore *files, std::string filepath, bool recur, const SortOrder &order){ //called at start and whenever a new folder is expanded/opened
+    TRACE_SCOPE("updateFileList");
+    
+    std::vector<ScanEntry> scanned;
+    
+    //flush store of prev info if it exists
+    files->clear();
+    
+    if(scanDirectory(filepath, &scanned)){
+        size_t name_bytes = 0;
+        for(int i = 0; i < scanned.size(); i++){
+            name_bytes += scanned[i].name.size() + 1;
+        }
+        files->reserve(scanned.size(), name_bytes);
+        for(int i = 0; i < scanned.size(); i++){
+            if(recur && scanned[i].name == ".."){
+                continue; //an expanded folder already sits under its parent
+            }
+            addScanEntry(files, scanned[i]);
+        }
+    }
+
+    files->sort(order);
+}
+
+void addScanEntry(EntryStore *files, const ScanEntry &entry){
+    const char *name = entry.name.c_str();
+    if(entry.kind == SCAN_DIR){
+        files->add(name, entry.name.size(), TYPE_DIRECTORY, entry.mode, 0, 0, entry.is_link);
+    } else { //regular file, or a link/special file that is not a folder
+        files->add(name, entry.name.size(), classifyFile(name, entry.name.size(), entry.mode), entry.mode, entry.size, entry.mtime, entry.is_link);
+    }
+}
+
+void fitFilesizeToUnit(uint64_t bytes, double *size, SizeUnit *units){
+    *size = bytes;
+    if (*size >= 1024 && *size < 1048576) {
+        *size = *size / 1024;
+        *units = UNIT_KB;
+    }else if (*size >= 1048576 && *size < 1073741824) {
+        *size = *size / 1048576;
+        *units = UNIT_MB;
+    }else if (*size >= 1073741824) {
+        *size = *size / 1073741824;
+        *units = UNIT_GB;
+    }else {
+        *units = UNIT_B;
+    }
+    *size = trunc(*size);
+}
+
+const char *unitName(SizeUnit units){
+    static const char *names[] = { "B", "KB", "MB", "GB" };
+    return names[units];
+}
+
+void setFilePermField(char *perms, mode_t mode){
+    char *p = perms;
+    *p++ = '[';
+    //Permissions
+    if( mode & S_IRUSR ){
+        *p++ = 'r';
+    }
+    if( mode & S_IWUSR ){
+        *p++ = 'w';
+    }
+    if( mode & S_IXUSR ){
+        *p++ = 'x';
+    }
+    p = stpcpy(p, "] | [");
+    if( mode & S_IRGRP ){
+        *p++ = 'r';
+    }
+    if( mode & S_IWGRP ){
+        *p++ = 'w';
+    }
+    if( mode & S_IXGRP ){
+        *p++ = 'x';
+    }
+    p = stpcpy(p, "] | [");
+    if( mode & S_IROTH ){
+        *p++ = 'r';
+    }
+    if( mode & S_IWOTH ){
+        *p++ = 'w';
+    }
+    if( mode & S_IXOTH ){
+        *p++ = 'x';
+    }
+    stpcpy(p, "]");
+}
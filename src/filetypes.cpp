@@ -0,0 +1,289 @@
+#include <unordered_map>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "filetypes.h"
+
+#define EXTENSION_MAX 8 //longest extension in the table, packed into a uint64_t
+#define TYPE_SLOTS 1024
+#define TYPE_SLOT_BITS 10
+#define TYPE_HASH 0x3c2cfc90c3239c35ull //no two built-in extensions share a slot with it
+#define SNIFF_BYTES 16
+
+struct ExtensionType {
+    const char *extension;
+    FileType type;
+};
+
+static constexpr ExtensionType builtin_types[] = {
+    { "jpg", TYPE_IMAGE }, { "jpeg", TYPE_IMAGE }, { "jpe", TYPE_IMAGE }, { "png", TYPE_IMAGE },
+    { "apng", TYPE_IMAGE }, { "gif", TYPE_IMAGE }, { "bmp", TYPE_IMAGE }, { "tif", TYPE_IMAGE },
+    { "tiff", TYPE_IMAGE }, { "webp", TYPE_IMAGE }, { "svg", TYPE_IMAGE }, { "svgz", TYPE_IMAGE },
+    { "ico", TYPE_IMAGE }, { "heic", TYPE_IMAGE }, { "heif", TYPE_IMAGE }, { "avif", TYPE_IMAGE },
+    { "jxl", TYPE_IMAGE }, { "tga", TYPE_IMAGE }, { "ppm", TYPE_IMAGE }, { "pgm", TYPE_IMAGE },
+    { "pbm", TYPE_IMAGE }, { "pnm", TYPE_IMAGE }, { "psd", TYPE_IMAGE }, { "xcf", TYPE_IMAGE },
+    { "raw", TYPE_IMAGE }, { "cr2", TYPE_IMAGE }, { "nef", TYPE_IMAGE }, { "arw", TYPE_IMAGE },
+    { "dng", TYPE_IMAGE }, { "orf", TYPE_IMAGE }, { "rw2", TYPE_IMAGE }, { "exr", TYPE_IMAGE },
+    { "hdr", TYPE_IMAGE }, { "qoi", TYPE_IMAGE },
+
+    { "mp4", TYPE_VIDEO }, { "m4v", TYPE_VIDEO }, { "mov", TYPE_VIDEO }, { "mkv", TYPE_VIDEO },
+    { "avi", TYPE_VIDEO }, { "webm", TYPE_VIDEO }, { "wmv", TYPE_VIDEO }, { "flv", TYPE_VIDEO },
+    { "mpg", TYPE_VIDEO }, { "mpeg", TYPE_VIDEO }, { "m2ts", TYPE_VIDEO }, { "mts", TYPE_VIDEO },
+    { "3gp", TYPE_VIDEO }, { "ogv", TYPE_VIDEO }, { "vob", TYPE_VIDEO }, { "mxf", TYPE_VIDEO },
+    { "asf", TYPE_VIDEO }, { "rm", TYPE_VIDEO }, { "rmvb", TYPE_VIDEO }, { "divx", TYPE_VIDEO },
+
+    { "h", TYPE_CODE }, { "hh", TYPE_CODE }, { "hpp", TYPE_CODE }, { "hxx", TYPE_CODE },
+    { "c", TYPE_CODE }, { "cc", TYPE_CODE }, { "cpp", TYPE_CODE }, { "cxx", TYPE_CODE },
+    { "inl", TYPE_CODE }, { "ipp", TYPE_CODE }, { "py", TYPE_CODE }, { "pyi", TYPE_CODE },
+    { "java", TYPE_CODE }, { "kt", TYPE_CODE }, { "kts", TYPE_CODE }, { "scala", TYPE_CODE },
+    { "groovy", TYPE_CODE }, { "js", TYPE_CODE }, { "mjs", TYPE_CODE }, { "cjs", TYPE_CODE },
+    { "ts", TYPE_CODE }, { "tsx", TYPE_CODE }, { "jsx", TYPE_CODE }, { "rs", TYPE_CODE },
+    { "go", TYPE_CODE }, { "rb", TYPE_CODE }, { "php", TYPE_CODE }, { "pl", TYPE_CODE },
+    { "pm", TYPE_CODE }, { "sh", TYPE_CODE }, { "bash", TYPE_CODE }, { "zsh", TYPE_CODE },
+    { "fish", TYPE_CODE }, { "lua", TYPE_CODE }, { "swift", TYPE_CODE }, { "m", TYPE_CODE },
+    { "mm", TYPE_CODE }, { "cs", TYPE_CODE }, { "fs", TYPE_CODE }, { "vb", TYPE_CODE },
+    { "hs", TYPE_CODE }, { "ml", TYPE_CODE }, { "mli", TYPE_CODE }, { "el", TYPE_CODE },
+    { "clj", TYPE_CODE }, { "cljs", TYPE_CODE }, { "erl", TYPE_CODE }, { "ex", TYPE_CODE },
+    { "exs", TYPE_CODE }, { "sql", TYPE_CODE }, { "r", TYPE_CODE }, { "jl", TYPE_CODE },
+    { "dart", TYPE_CODE }, { "zig", TYPE_CODE }, { "nim", TYPE_CODE }, { "d", TYPE_CODE },
+    { "asm", TYPE_CODE }, { "s", TYPE_CODE }, { "css", TYPE_CODE }, { "scss", TYPE_CODE },
+    { "sass", TYPE_CODE }, { "less", TYPE_CODE }, { "html", TYPE_CODE }, { "htm", TYPE_CODE },
+    { "xml", TYPE_CODE }, { "json", TYPE_CODE }, { "yaml", TYPE_CODE }, { "yml", TYPE_CODE },
+    { "toml", TYPE_CODE }, { "ini", TYPE_CODE }, { "cmake", TYPE_CODE }, { "mk", TYPE_CODE },
+    { "vue", TYPE_CODE }, { "svelte", TYPE_CODE }, { "proto", TYPE_CODE }, { "glsl", TYPE_CODE },
+    { "hlsl", TYPE_CODE }, { "cu", TYPE_CODE }, { "f90", TYPE_CODE }, { "pas", TYPE_CODE },
+    { "tcl", TYPE_CODE }, { "awk", TYPE_CODE }, { "sed", TYPE_CODE }, { "bat", TYPE_CODE },
+    { "ps1", TYPE_CODE }
+};
+
+static constexpr int BUILTIN_COUNT = sizeof(builtin_types) / sizeof(builtin_types[0]);
+
+//an extension's bytes, lowercase, little-endian in one word
+static constexpr uint64_t packExtension(const char *extension, int i){
+    return extension[i] == '\0' ? 0 : ((uint64_t)(unsigned char)extension[i] << (8 * i)) | packExtension(extension, i + 1);
+}
+
+static constexpr int slotOf(uint64_t key){
+    return (int)((key * TYPE_HASH) >> (64 - TYPE_SLOT_BITS));
+}
+
+static constexpr int builtinSlot(int i){
+    return slotOf(packExtension(builtin_types[i].extension, 0));
+}
+
+//whether built-in i shares its slot with one after it (j onwards)
+static constexpr bool sharesSlot(int i, int j){
+    return j < BUILTIN_COUNT && (builtinSlot(i) == builtinSlot(j) || sharesSlot(i, j + 1));
+}
+
+static constexpr bool perfectFrom(int i){
+    return i >= BUILTIN_COUNT || (!sharesSlot(i, i + 1) && perfectFrom(i + 1));
+}
+
+static_assert(perfectFrom(0), "built-in extensions collide, look for another TYPE_HASH");
+static_assert(BUILTIN_COUNT < 255, "slot entries are one byte");
+
+//which built-in sits in a slot, 255 for none
+static constexpr unsigned char entryInSlot(int slot, int i){
+    return i >= BUILTIN_COUNT ? 255 : builtinSlot(i) == slot ? i : entryInSlot(slot, i + 1);
+}
+
+static constexpr uint64_t builtinKey(int i){
+    return i < BUILTIN_COUNT ? packExtension(builtin_types[i].extension, 0) : 0;
+}
+
+static constexpr unsigned char builtinType(int i){
+    return i < BUILTIN_COUNT ? builtin_types[i].type : TYPE_OTHER;
+}
+
+//0, 1, ... N - 1 as a parameter pack, N a power of two
+template<int... I> struct Indices {
+    typedef Indices<I..., (int)sizeof...(I) + I...> doubled;
+};
+template<int N> struct MakeIndices {
+    typedef typename MakeIndices<N / 2>::type::doubled type;
+};
+template<> struct MakeIndices<1> {
+    typedef Indices<0> type;
+};
+
+#define ENTRY_SLOTS 256 //BUILTIN_COUNT rounded up to a power of two
+
+struct TypeTable {
+    unsigned char slots[TYPE_SLOTS];  //index into keys and types
+    uint64_t keys[ENTRY_SLOTS];
+    unsigned char types[ENTRY_SLOTS];
+};
+
+template<int... S, int... E>
+static constexpr TypeTable makeTable(Indices<S...>, Indices<E...>){
+    return TypeTable{ { entryInSlot(S, 0)... }, { builtinKey(E)... }, { builtinType(E)... } };
+}
+
+static_assert(BUILTIN_COUNT <= ENTRY_SLOTS, "raise ENTRY_SLOTS");
+static constexpr TypeTable type_table = makeTable(MakeIndices<TYPE_SLOTS>::type(), MakeIndices<ENTRY_SLOTS>::type());
+
+//from the config file, looked at before the table
+static std::unordered_map<uint64_t, FileType> user_types;
+
+//the key of name's extension. false if it has none (no dot, or only the
+//leading one of a hidden file), key 0 if it is too long for the table.
+static bool extensionKey(const char *name, size_t len, uint64_t *key){
+    const char *dot = (const char *)memrchr(name, '.', len);
+    if(dot == NULL || dot == name){
+        return false;
+    }
+    size_t ext_len = name + len - dot - 1;
+    *key = 0;
+    if(ext_len == 0 || ext_len > EXTENSION_MAX){
+        return true;
+    }
+    for(size_t i = 0; i < ext_len; i++){
+        unsigned char c = dot[1 + i];
+        if(c >= 'A' && c <= 'Z'){
+            c += 'a' - 'A';
+        }
+        *key |= (uint64_t)c << (8 * i);
+    }
+    return true;
+}
+
+FileType classifyFile(const char *name, size_t len, mode_t mode){
+    uint64_t key;
+    bool has_extension = extensionKey(name, len, &key);
+    if(has_extension && key != 0){
+        if(!user_types.empty()){
+            std::unordered_map<uint64_t, FileType>::const_iterator found = user_types.find(key);
+            if(found != user_types.end()){
+                return found->second;
+            }
+        }
+        unsigned char entry = type_table.slots[slotOf(key)];
+        if(entry != 255 && type_table.keys[entry] == key){
+            return (FileType)type_table.types[entry];
+        }
+    }
+    if(mode & (S_IXUSR | S_IXGRP | S_IXOTH)){
+        return TYPE_EXECUTABLE;
+    }
+    return has_extension ? TYPE_OTHER : TYPE_UNKNOWN;
+}
+
+static bool typeNamed(const char *word, FileType *type){
+    static const char *names[] = { "image", "video", "code", "executable", "other" };
+    static const FileType types[] = { TYPE_IMAGE, TYPE_VIDEO, TYPE_CODE, TYPE_EXECUTABLE, TYPE_OTHER };
+    for(int i = 0; i < sizeof(names) / sizeof(names[0]); i++){
+        if(strcmp(word, names[i]) == 0){
+            *type = types[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+int loadFileTypes(const std::string &file){
+    FILE *config = fopen(file.c_str(), "r");
+    if(config == NULL){
+        return -1;
+    }
+    int taken = 0;
+    char line[1024];
+    int line_number = 0;
+    while(fgets(line, sizeof(line), config) != NULL){
+        line_number++;
+        char *comment = strchr(line, '#');
+        if(comment != NULL){
+            *comment = '\0';
+        }
+        char *save;
+        char *word = strtok_r(line, " \t\r\n", &save);
+        if(word == NULL){
+            continue;
+        }
+        FileType type;
+        if(!typeNamed(word, &type)){
+            fprintf(stderr, "%s:%d: unknown type '%s'\n", file.c_str(), line_number, word);
+            continue;
+        }
+        while((word = strtok_r(NULL, " \t\r\n", &save)) != NULL){
+            if(word[0] == '.'){
+                word++; //".heic" is fine too
+            }
+            uint64_t key;
+            std::string name = std::string("x.") + word;
+            if(!extensionKey(name.c_str(), name.size(), &key) || key == 0){
+                fprintf(stderr, "%s:%d: '%s' is no extension of at most %d characters\n",
+                        file.c_str(), line_number, word, EXTENSION_MAX);
+                continue;
+            }
+            user_types[key] = type;
+            taken++;
+        }
+    }
+    fclose(config);
+    return taken;
+}
+
+std::string fileTypesFile(){
+    const char *config = getenv("XDG_CONFIG_HOME");
+    std::string dir;
+    if(config != NULL && config[0] == '/'){
+        dir = config;
+    } else {
+        const char *home = getenv("HOME");
+        dir = std::string(home != NULL ? home : "") + "/.config";
+    }
+    return dir + "/os-fileexplorer/filetypes";
+}
+
+const char *typeName(FileType type){
+    static const char *names[] = { "folder", "executable", "image", "video", "code", "other", "unknown" };
+    return names[type];
+}
+
+FileType sniffFileType(const char *path){
+    unsigned char head[SNIFF_BYTES];
+    int fd = open(path, O_RDONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC);
+    if(fd < 0){
+        return TYPE_OTHER;
+    }
+    ssize_t got = read(fd, head, sizeof(head));
+    close(fd);
+    if(got < 4){
+        return TYPE_OTHER;
+    }
+
+    if(memcmp(head, "\x89PNG", 4) == 0 || memcmp(head, "\xff\xd8\xff", 3) == 0 || memcmp(head, "GIF8", 4) == 0 ||
+       memcmp(head, "II*\0", 4) == 0 || memcmp(head, "MM\0*", 4) == 0 || memcmp(head, "qoif", 4) == 0){
+        return TYPE_IMAGE;
+    }
+    if(memcmp(head, "\x1a\x45\xdf\xa3", 4) == 0 || memcmp(head, "\0\0\x01\xba", 4) == 0){
+        return TYPE_VIDEO; //matroska / webm, mpeg program stream
+    }
+    if(memcmp(head, "\x7f" "ELF", 4) == 0){
+        return TYPE_EXECUTABLE;
+    }
+    if(head[0] == '#' && head[1] == '!'){
+        return TYPE_CODE;
+    }
+    if(got >= 12 && memcmp(head, "RIFF", 4) == 0){
+        if(memcmp(head + 8, "WEBP", 4) == 0){
+            return TYPE_IMAGE;
+        }
+        if(memcmp(head + 8, "AVI ", 4) == 0){
+            return TYPE_VIDEO;
+        }
+    }
+    if(got >= 12 && memcmp(head + 4, "ftyp", 4) == 0){ //iso media, the brand says which
+        if(memcmp(head + 8, "heic", 4) == 0 || memcmp(head + 8, "heix", 4) == 0 ||
+           memcmp(head + 8, "mif1", 4) == 0 || memcmp(head + 8, "avif", 4) == 0){
+            return TYPE_IMAGE;
+        }
+        return TYPE_VIDEO;
+    }
+    return TYPE_OTHER;
+}
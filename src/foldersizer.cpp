@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "foldersizer.h"
+#include "scanner.h"
+
+#define LINK_SHARDS 16
+
+//one measured folder and what its walk shares
+struct FolderSizer::Walk {
+    std::string path;
+    dev_t dev;
+    std::atomic<bool> cancelled;
+    std::atomic<uint64_t> bytes; //running total of the whole walk, for display
+    std::atomic<uint64_t> files;
+
+    //(dev, inode) of files with more than one link, split to keep threads apart
+    struct LinkHash {
+        size_t operator()(const std::pair<dev_t, ino_t> &key) const {
+            return std::hash<uint64_t>()(key.second * 31 + key.first);
+        }
+    };
+    struct Links {
+        std::mutex lock;
+        std::unordered_set<std::pair<dev_t, ino_t>, LinkHash> seen;
+    };
+    Links links[LINK_SHARDS];
+
+    //true the first time an inode comes up
+    bool firstLink(dev_t dev, ino_t ino){
+        Links &shard = links[ino % LINK_SHARDS];
+        std::lock_guard<std::mutex> guard(shard.lock);
+        return shard.seen.insert(std::make_pair(dev, ino)).second;
+    }
+};
+
+//a folder being counted. pending is its own listing plus every subfolder
+//not finished yet, whoever takes it to zero finishes the folder.
+struct FolderSizer::Folder {
+    std::string path;
+    Folder *parent;
+    Walk *walk;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> files;
+    std::atomic<int> pending;
+
+    Folder(const std::string &p, Folder *up, Walk *w, uint64_t own_bytes)
+        : path(p), parent(up), walk(w), bytes(own_bytes), files(0), pending(1) {}
+};
+
+FolderSizer::FolderSizer(std::function<void()> wake_fn, unsigned thread_count)
+    : wake(wake_fn), quitting(false), next_stamp(0), walks(0)
+{
+    if(thread_count == 0){
+        thread_count = std::max(4u, std::thread::hardware_concurrency());
+    }
+    for(unsigned t = 0; t < thread_count; t++){
+        threads.push_back(std::thread(&FolderSizer::run, this));
+    }
+}
+
+FolderSizer::~FolderSizer(){
+    forget();
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        quitting = true;
+    }
+    work_ready.notify_all();
+    for(int t = 0; t < threads.size(); t++){
+        threads[t].join();
+    }
+}
+
+void FolderSizer::measure(const std::string &path){
+    std::lock_guard<std::mutex> guard(lock);
+    if(sizes.count(path) != 0 || counting.count(path) != 0){
+        return;
+    }
+    struct stat st;
+    if(lstat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)){
+        return;
+    }
+    Walk *walk = new Walk();
+    walk->path = path;
+    walk->dev = st.st_dev;
+    walk->cancelled = false;
+    walk->bytes = st.st_blocks * 512;
+    walk->files = 0;
+    Folder *folder = new Folder(path, NULL, walk, st.st_blocks * 512);
+    active.push_back(walk);
+    counting[path] = folder;
+    work.push_back(folder);
+    walks++;
+    work_ready.notify_one();
+}
+
+bool FolderSizer::size(const std::string &path, FolderSize *out){
+    std::lock_guard<std::mutex> guard(lock);
+    std::unordered_map<std::string, Known>::iterator known = sizes.find(path);
+    if(known != sizes.end()){
+        *out = known->second.size;
+        return true;
+    }
+    std::unordered_map<std::string, Folder *>::iterator running = counting.find(path);
+    if(running == counting.end()){
+        return false;
+    }
+    //a measured folder shows everything found so far, one below it only
+    //what its finished subfolders add up to
+    Folder *folder = running->second;
+    bool measured = folder->parent == NULL;
+    out->bytes = measured ? folder->walk->bytes.load() : folder->bytes.load();
+    out->files = measured ? folder->walk->files.load() : folder->files.load();
+    out->done = false;
+    return true;
+}
+
+void FolderSizer::forget(){
+    std::lock_guard<std::mutex> guard(lock);
+    for(int i = 0; i < active.size(); i++){
+        active[i]->cancelled = true; //its folders are still taken down, uncounted
+    }
+    sizes.clear();
+    kept_order.clear();
+}
+
+//true if folder is path or one of the folders above it
+static bool contains(const std::string &folder, const std::string &path){
+    if(path.compare(0, folder.size(), folder) != 0){
+        return false;
+    }
+    return path.size() == folder.size() || folder == "/" || path[folder.size()] == '/';
+}
+
+void FolderSizer::forget(const std::string &path){
+    std::lock_guard<std::mutex> guard(lock);
+    std::string folder = path;
+    while(true){
+        sizes.erase(folder);
+        size_t slash = folder.rfind('/');
+        if(slash == std::string::npos || folder == "/"){
+            break;
+        }
+        folder = slash == 0 ? "/" : folder.substr(0, slash);
+    }
+
+    //a walk over it may have counted it already. its folders leave counting
+    //now, so asking again starts a fresh walk while the old one drains
+    bool stopped = false;
+    for(int i = 0; i < active.size(); i++){
+        if(contains(active[i]->path, path) && !active[i]->cancelled){
+            active[i]->cancelled = true;
+            stopped = true;
+        }
+    }
+    if(stopped){
+        for(std::unordered_map<std::string, Folder *>::iterator it = counting.begin(); it != counting.end();){
+            if(it->second->walk->cancelled){
+                it = counting.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+//records a finished total, pushing out the oldest past FOLDER_SIZES_MAX. lock held
+void FolderSizer::keep(const std::string &path, const FolderSize &total){
+    Known &known = sizes[path];
+    known.size = total;
+    known.stamp = next_stamp++;
+    kept_order.push_back(std::make_pair(path, known.stamp));
+    while(sizes.size() > FOLDER_SIZES_MAX || kept_order.size() > 2 * FOLDER_SIZES_MAX){
+        std::unordered_map<std::string, Known>::iterator oldest = sizes.find(kept_order.front().first);
+        if(oldest != sizes.end() && oldest->second.stamp == kept_order.front().second){
+            sizes.erase(oldest);
+        }
+        kept_order.pop_front();
+    }
+}
+
+void FolderSizer::run(){
+    while(true){
+        Folder *folder;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            work_ready.wait(guard, [this](){ return quitting || !work.empty(); });
+            if(work.empty()){
+                return; //quitting, and forget() has drained every walk
+            }
+            folder = work.back();
+            work.pop_back();
+        }
+        count(folder);
+    }
+}
+
+//lists one folder, adds up its files and queues its subfolders
+void FolderSizer::count(Folder *folder){
+    Walk *walk = folder->walk;
+    int dirfd = walk->cancelled ? -1 : open(folder->path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if(dirfd < 0){
+        finish(folder);
+        return;
+    }
+
+    uint64_t bytes = 0;
+    uint64_t files = 0;
+    std::vector<Folder *> subfolders;
+    const std::string prefix = (folder->path == "/" ? "" : folder->path) + "/";
+    listNames(dirfd, [&](const char *name, unsigned char d_type){
+        struct stat st;
+        if(fstatat(dirfd, name, &st, AT_SYMLINK_NOFOLLOW) != 0){
+            return; //gone already
+        }
+        uint64_t used = st.st_blocks * 512;
+        if(S_ISDIR(st.st_mode)){
+            if(st.st_dev == walk->dev){
+                subfolders.push_back(new Folder(prefix + name, folder, walk, used));
+                bytes += used; //only for the walk total, the subfolder carries it up itself
+            }
+            return;
+        }
+        if(st.st_nlink > 1 && !walk->firstLink(st.st_dev, st.st_ino)){
+            return;
+        }
+        bytes += used;
+        files++;
+    });
+    close(dirfd);
+
+    uint64_t own = bytes;
+    for(int i = 0; i < subfolders.size(); i++){
+        own -= subfolders[i]->bytes;
+    }
+    folder->bytes += own;
+    folder->files += files;
+    walk->bytes += bytes;
+    walk->files += files;
+    folder->pending += subfolders.size();
+
+    if(!subfolders.empty()){
+        std::lock_guard<std::mutex> guard(lock);
+        for(int i = 0; i < subfolders.size(); i++){
+            counting.insert(std::make_pair(subfolders[i]->path, subfolders[i]));
+            work.push_back(subfolders[i]);
+        }
+    }
+    work_ready.notify_all();
+    finish(folder);
+}
+
+//drops one of the folder's pending counts. the last one records its total
+//and hands it to the parent, which may finish in turn.
+void FolderSizer::finish(Folder *folder){
+    while(folder != NULL && --folder->pending == 0){
+        Folder *parent = folder->parent;
+        Walk *walk = folder->walk;
+        FolderSize total;
+        total.bytes = folder->bytes;
+        total.files = folder->files;
+        total.done = true;
+        if(parent != NULL){
+            parent->bytes += total.bytes;
+            parent->files += total.files;
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            std::unordered_map<std::string, Folder *>::iterator entry = counting.find(folder->path);
+            if(entry != counting.end() && entry->second == folder){
+                counting.erase(entry);
+            }
+            if(!walk->cancelled){
+                keep(folder->path, total);
+            }
+            if(parent == NULL){
+                active.erase(std::find(active.begin(), active.end(), walk));
+            }
+        }
+        delete folder;
+        if(parent == NULL){
+            bool cancelled = walk->cancelled;
+            delete walk;
+            walks--;
+            if(!cancelled){
+                wake();
+            }
+        }
+        folder = parent;
+    }
+}
@@ -0,0 +1,132 @@
+#include "framecache.h"
+#include "trace.h"
+
+FrameCache::FrameCache(ResourcePool *pool, int w, int h)
+    : pool(pool), w(w), h(h), ready(false), chrome_key(0), chrome_drawn(false), drawing_now(false), shown(false)
+{
+    area.x = area.y = area.w = area.h = 0;
+    counts.drawn = 0;
+    counts.skipped = 0;
+    counts.last_area = 0;
+}
+
+void FrameCache::damage(const SDL_Rect &rect){
+    SDL_Rect screen = { 0, 0, w, h };
+    SDL_Rect part;
+    if(!SDL_IntersectRect(&rect, &screen, &part)){
+        return;
+    }
+    if(area.w > 0){
+        SDL_UnionRect(&area, &part, &area);
+    } else {
+        area = part;
+    }
+}
+
+void FrameCache::damageAll(){
+    area.x = 0;
+    area.y = 0;
+    area.w = w;
+    area.h = h;
+}
+
+void FrameCache::exposed(){
+    shown = false;
+    if(ready && !frame){
+        damageAll(); //nothing kept to show again
+    }
+}
+
+void FrameCache::lost(){
+    chrome_drawn = false;
+    damageAll();
+}
+
+void FrameCache::composeChrome(unsigned key, std::function<void()> draw){
+    if(draw_chrome && key == chrome_key){
+        return;
+    }
+    draw_chrome = draw;
+    chrome_key = key;
+    chrome_drawn = false;
+    damageAll();
+}
+
+//first frame: the textures, or none of them if the renderer cannot draw into one
+void FrameCache::setUp(SDL_Renderer *renderer){
+    if(ready){
+        return;
+    }
+    ready = true;
+    if(!SDL_RenderTargetSupported(renderer)){
+        return;
+    }
+    frame = pool->createTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, w, h);
+    chrome = pool->createTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, w, h);
+    if(!frame || !chrome){
+        frame.reset();
+        chrome.reset();
+        return;
+    }
+    SDL_SetTextureBlendMode(chrome.get(), SDL_BLENDMODE_BLEND);
+}
+
+void FrameCache::drawChrome(SDL_Renderer *renderer){
+    if(!draw_chrome){
+        return;
+    }
+    if(!chrome){
+        draw_chrome(); //straight into the frame
+        return;
+    }
+    if(!chrome_drawn){
+        SDL_RenderSetClipRect(renderer, NULL);
+        SDL_SetRenderTarget(renderer, chrome.get());
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+        SDL_RenderClear(renderer);
+        draw_chrome();
+        SDL_SetRenderTarget(renderer, frame.get());
+        SDL_RenderSetClipRect(renderer, &area);
+        chrome_drawn = true;
+    }
+    SDL_RenderCopy(renderer, chrome.get(), &area, &area);
+    TRACE_COUNT(TRACE_DRAW_CALLS, 1);
+}
+
+bool FrameCache::begin(SDL_Renderer *renderer, const SDL_Color &background){
+    setUp(renderer);
+    if(!damaged()){
+        return false;
+    }
+    if(!frame){
+        damageAll(); //the back buffer holds nothing from the last frame
+    }
+    SDL_SetRenderTarget(renderer, frame.get());
+    SDL_RenderSetClipRect(renderer, &area);
+    SDL_SetRenderDrawColor(renderer, background.r, background.g, background.b, background.a);
+    SDL_RenderFillRect(renderer, &area);
+    TRACE_COUNT(TRACE_DRAW_CALLS, 1);
+    drawing_now = true;
+    return true;
+}
+
+void FrameCache::end(SDL_Renderer *renderer){
+    if(drawing_now){
+        drawChrome(renderer);
+        SDL_RenderSetClipRect(renderer, NULL);
+        counts.drawn++;
+        counts.last_area = area.w * area.h;
+        area.w = area.h = 0;
+        drawing_now = false;
+    } else if(shown || !frame){
+        counts.skipped++;
+        return;
+    }
+    if(frame){
+        SDL_SetRenderTarget(renderer, NULL);
+        SDL_RenderCopy(renderer, frame.get(), NULL, NULL);
+        TRACE_COUNT(TRACE_DRAW_CALLS, 1);
+    }
+    SDL_RenderPresent(renderer);
+    shown = true;
+}
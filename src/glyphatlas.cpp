@@ -0,0 +1,133 @@
+#include "glyphatlas.h"
+#include "trace.h"
+
+#define ATLAS_WIDTH 512
+#define FIRST_GLYPH 32     //control characters are drawn as '?'
+#define FALLBACK_GLYPH '?'
+
+GlyphAtlas::GlyphAtlas(ResourcePool *pool) : glyphs(), pool(pool), atlas_w(0), atlas_h(0), line_height(0)
+{
+}
+
+bool GlyphAtlas::load(SDL_Renderer *renderer, const char *font_path, int pt_size, SDL_Color color){
+    FontHandle handle = pool->openFont(font_path, pt_size);
+    if(!handle){
+        return false;
+    }
+    TTF_Font *font = handle.get();
+    line_height = TTF_FontHeight(font);
+
+    //render every glyph once, then shelf-pack them into rows of ATLAS_WIDTH
+    SDL_Surface *rendered[256] = { NULL };
+    int pen_x = 0;
+    int pen_y = 0;
+    int row_h = 0;
+    for(int c = FIRST_GLYPH; c < 256; c++){
+        if(c == 127){
+            continue; //DEL
+        }
+        int minx, maxx, miny, maxy, advance;
+        if(TTF_GlyphMetrics(font, c, &minx, &maxx, &miny, &maxy, &advance) != 0){
+            continue;
+        }
+        rendered[c] = TTF_RenderGlyph_Blended(font, c, color);
+        if(rendered[c] == NULL){
+            continue;
+        }
+        if(pen_x + rendered[c]->w > ATLAS_WIDTH){
+            pen_x = 0;
+            pen_y += row_h;
+            row_h = 0;
+        }
+        glyphs[c].src.x = pen_x;
+        glyphs[c].src.y = pen_y;
+        glyphs[c].src.w = rendered[c]->w;
+        glyphs[c].src.h = rendered[c]->h;
+        glyphs[c].advance = advance;
+        pen_x += rendered[c]->w + 1; //1px gap so neighbours do not bleed when filtered
+        if(rendered[c]->h > row_h){
+            row_h = rendered[c]->h;
+        }
+    }
+    handle.reset(); //everything is rendered, the font is not needed again
+    atlas_w = ATLAS_WIDTH;
+    atlas_h = pen_y + row_h;
+
+    //anything the font could not render borrows the fallback glyph
+    for(int c = 0; c < 256; c++){
+        if(rendered[c] == NULL){
+            glyphs[c] = glyphs[FALLBACK_GLYPH];
+        }
+    }
+
+    SDL_Surface *sheet = SDL_CreateRGBSurfaceWithFormat(0, atlas_w, atlas_h, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_FillRect(sheet, NULL, 0); //fully transparent
+    for(int c = 0; c < 256; c++){
+        if(rendered[c] == NULL){
+            continue;
+        }
+        SDL_SetSurfaceBlendMode(rendered[c], SDL_BLENDMODE_NONE); //copy alpha as is
+        SDL_Rect dest = glyphs[c].src;
+        SDL_BlitSurface(rendered[c], NULL, sheet, &dest);
+        SDL_FreeSurface(rendered[c]);
+    }
+
+    texture = pool->createTexture(renderer, sheet);
+    SDL_FreeSurface(sheet);
+    if(!texture){
+        return false;
+    }
+    SDL_SetTextureBlendMode(texture.get(), SDL_BLENDMODE_BLEND);
+    return true;
+}
+
+int GlyphAtlas::measure(const char *text, size_t len){
+    int w = 0;
+    for(size_t i = 0; i < len; i++){
+        w += glyphs[(unsigned char)text[i]].advance;
+    }
+    return w;
+}
+
+void GlyphAtlas::draw(const char *text, size_t len, int x, int y){
+    SDL_Color white = { 255, 255, 255, 255 }; //colour is baked into the atlas
+    float tex_w = atlas_w;
+    float tex_h = atlas_h;
+    int pen = x;
+    for(size_t i = 0; i < len; i++){
+        const Glyph &g = glyphs[(unsigned char)text[i]];
+        int base = vertices.size();
+        float x0 = pen;
+        float y0 = y;
+        float x1 = pen + g.src.w;
+        float y1 = y + g.src.h;
+        float u0 = g.src.x / tex_w;
+        float v0 = g.src.y / tex_h;
+        float u1 = (g.src.x + g.src.w) / tex_w;
+        float v1 = (g.src.y + g.src.h) / tex_h;
+
+        SDL_Vertex corners[4] = {
+            { { x0, y0 }, white, { u0, v0 } },
+            { { x1, y0 }, white, { u1, v0 } },
+            { { x1, y1 }, white, { u1, v1 } },
+            { { x0, y1 }, white, { u0, v1 } }
+        };
+        vertices.insert(vertices.end(), corners, corners + 4);
+        int quad[6] = { base, base + 1, base + 2, base, base + 2, base + 3 };
+        indices.insert(indices.end(), quad, quad + 6);
+        pen += g.advance;
+    }
+}
+
+void GlyphAtlas::flush(SDL_Renderer *renderer){
+    if(!indices.empty()){
+        SDL_RenderGeometry(renderer, texture.get(), vertices.data(), vertices.size(), indices.data(), indices.size());
+        TRACE_COUNT(TRACE_DRAW_CALLS, 1);
+    }
+    vertices.clear();
+    indices.clear();
+}
+
+int GlyphAtlas::lineHeight(){
+    return line_height;
+}
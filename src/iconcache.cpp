@@ -0,0 +1,96 @@
+#include <SDL_image.h>
+#include "iconcache.h"
+#include "trace.h"
+
+#define ICON_GAP 2 //keeps neighbours from bleeding in when icons are scaled down
+
+//file for each IconId, in enum order
+static const char *icon_files[ICON_COUNT] = {
+    "dir.png",
+    "exe.png",
+    "img.png",
+    "vid.png",
+    "code.png",
+    "oth.png",
+    "tips.png",
+    "recur_on.png",
+    "recur_off.png",
+    "UST.png"
+};
+
+IconCache::IconCache(ResourcePool *pool) : pool(pool)
+{
+    for(int i = 0; i < ICON_COUNT; i++){
+        present[i] = false;
+    }
+}
+
+bool IconCache::load(SDL_Renderer *renderer, const std::string &image_dir){
+    //decode everything once and lay the icons side by side in one strip
+    SDL_Surface *images[ICON_COUNT];
+    int strip_w = 0;
+    int strip_h = 0;
+    for(int i = 0; i < ICON_COUNT; i++){
+        std::string path = image_dir + "/" + icon_files[i];
+        images[i] = IMG_Load(path.c_str());
+        if(images[i] == NULL){
+            continue;
+        }
+        cells[i].x = strip_w;
+        cells[i].y = 0;
+        cells[i].w = images[i]->w;
+        cells[i].h = images[i]->h;
+        present[i] = true;
+        strip_w += images[i]->w + ICON_GAP;
+        if(images[i]->h > strip_h){
+            strip_h = images[i]->h;
+        }
+    }
+    if(strip_w == 0){
+        return false;
+    }
+
+    SDL_Surface *sheet = SDL_CreateRGBSurfaceWithFormat(0, strip_w, strip_h, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_FillRect(sheet, NULL, 0);
+    for(int i = 0; i < ICON_COUNT; i++){
+        if(images[i] == NULL){
+            continue;
+        }
+        SDL_SetSurfaceBlendMode(images[i], SDL_BLENDMODE_NONE); //copy alpha as is
+        SDL_Rect dest = cells[i];
+        SDL_BlitSurface(images[i], NULL, sheet, &dest);
+        SDL_FreeSurface(images[i]);
+    }
+
+    texture = pool->createTexture(renderer, sheet);
+    SDL_FreeSurface(sheet);
+    if(!texture){
+        return false;
+    }
+    SDL_SetTextureBlendMode(texture.get(), SDL_BLENDMODE_BLEND);
+    return true;
+}
+
+void IconCache::draw(SDL_Renderer *renderer, IconId icon, const SDL_Rect *dest){
+    if(icon < ICON_COUNT && present[icon]){
+        SDL_RenderCopy(renderer, texture.get(), &cells[icon], dest);
+        TRACE_COUNT(TRACE_DRAW_CALLS, 1);
+    }
+}
+
+IconId iconForType(FileType type){
+    switch(type){
+        case TYPE_DIRECTORY:
+            return ICON_DIR;
+        case TYPE_EXECUTABLE:
+            return ICON_EXE;
+        case TYPE_IMAGE:
+            return ICON_IMG;
+        case TYPE_VIDEO:
+            return ICON_VID;
+        case TYPE_CODE:
+            return ICON_CODE;
+        default:
+            return ICON_OTHER;
+    }
+}
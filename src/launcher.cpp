@@ -0,0 +1,137 @@
+#include <chrono>
+#include <spawn.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "launcher.h"
+#include "trace.h"
+
+extern char **environ;
+
+//the handler only writes a byte, everything else happens on the threads
+static int child_pipe[2] = { -1, -1 };
+static volatile sig_atomic_t child_ended = 0;
+
+static void onChild(int signal){
+    int saved = errno;
+    child_ended = 1;
+    char byte = 0;
+    if(write(child_pipe[1], &byte, 1) < 0){
+        //full pipe, a wake is pending anyway
+    }
+    errno = saved;
+}
+
+Launcher::Launcher(std::function<void()> wake_fn, const std::string &opener)
+    : wake(wake_fn), opener(opener), last_us(0), worst_us(0)
+{
+    if(pipe2(child_pipe, O_CLOEXEC) != 0){
+        return;
+    }
+    fcntl(child_pipe[1], F_SETFL, O_NONBLOCK);
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onChild;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &action, NULL);
+    watcher = std::thread(&Launcher::run, this);
+}
+
+Launcher::~Launcher(){
+    signal(SIGCHLD, SIG_DFL);
+    if(child_pipe[1] >= 0){
+        close(child_pipe[1]); //the watcher reads end of file and stops
+        child_pipe[1] = -1;
+    }
+    if(watcher.joinable()){
+        watcher.join();
+    }
+    if(child_pipe[0] >= 0){
+        close(child_pipe[0]);
+        child_pipe[0] = -1;
+    }
+    //children still running are left to init
+}
+
+void Launcher::run(){
+    char bytes[64];
+    while(true){
+        ssize_t got = read(child_pipe[0], bytes, sizeof(bytes));
+        if(got == 0 || (got < 0 && errno != EINTR)){
+            return;
+        }
+        if(got > 0){
+            wake();
+        }
+    }
+}
+
+bool Launcher::open(const std::vector<std::string> &paths, std::string *error){
+    TRACE_SCOPE("launch");
+    //the child starts with default signal handling and nothing blocked, in a
+    //session of its own so closing the explorer's terminal leaves it alone
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t none, defaults;
+    sigemptyset(&none);
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGCHLD);
+    sigaddset(&defaults, SIGPIPE);
+    posix_spawnattr_setsigmask(&attributes, &none);
+    posix_spawnattr_setsigdefault(&attributes, &defaults);
+    short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+#ifdef POSIX_SPAWN_SETSID
+    flags |= POSIX_SPAWN_SETSID;
+#endif
+    posix_spawnattr_setflags(&attributes, flags);
+
+    bool all = true;
+    for(int i = 0; i < paths.size(); i++){
+        char *argv[] = { (char *)opener.c_str(), (char *)paths[i].c_str(), NULL };
+        pid_t pid;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        int failed = posix_spawnp(&pid, opener.c_str(), NULL, &attributes, argv, environ);
+        std::chrono::duration<double, std::micro> took = std::chrono::steady_clock::now() - start;
+        last_us = took.count();
+        if(last_us > worst_us){
+            worst_us = last_us;
+        }
+        if(failed != 0){
+            if(all && error != NULL){
+                *error = opener + " " + paths[i] + ": " + strerror(failed);
+            }
+            all = false;
+            continue;
+        }
+        children[pid] = paths[i];
+    }
+    posix_spawnattr_destroy(&attributes);
+    return all;
+}
+
+void Launcher::reap(std::vector<LaunchResult> *ended){
+    ended->clear();
+    if(!child_ended || children.empty()){
+        return;
+    }
+    child_ended = 0; //before waiting, a child ending meanwhile sets it again
+    std::map<pid_t, std::string>::iterator child = children.begin();
+    while(child != children.end()){
+        int status;
+        pid_t done = waitpid(child->first, &status, WNOHANG);
+        if(done == 0 || (done < 0 && errno == EINTR)){
+            ++child;
+            continue;
+        }
+        //done, or not ours to wait for any more (ECHILD)
+        LaunchResult result;
+        result.path = child->second;
+        result.status = done < 0 ? -1 : WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        ended->push_back(result);
+        children.erase(child++);
+    }
+}
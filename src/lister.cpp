@@ -0,0 +1,260 @@
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "lister.h"
+#include "treewalker.h"
+#include "filetypes.h"
+#include "trace.h"
+
+#define LIST_RECORD_MAX 32768 //longest record, a PATH_MAX path with every byte escaped
+
+//fills one big buffer and hands it to write() when the next record might not fit
+class ListWriter {
+    public:
+        ListWriter(int fd, ListFormat format) : fd(fd), format(format), used(0), failed(false), total(0){
+            buffer.resize(LIST_BUFFER_BYTES);
+            if(format == LIST_BINARY){
+                uint32_t version = LIST_BINARY_VERSION;
+                put(LIST_BINARY_MAGIC, 8);
+                put(&version, sizeof(version));
+            }
+        }
+
+        //writes the entries of one folder, returns how many
+        size_t folder(const TreeNode &node);
+        bool flush();
+        bool ok() const { return !failed; }
+        size_t written() const { return total; }
+
+    private:
+        void room(size_t bytes){
+            if(used + bytes > buffer.size()){
+                flush();
+            }
+        }
+        void put(const void *bytes, size_t len){
+            memcpy(&buffer[used], bytes, len);
+            used += len;
+        }
+        void putText(const char *text){
+            put(text, strlen(text));
+        }
+        void putEscaped(const char *text, size_t len);
+        void putNumber(int64_t value);
+
+        int fd;
+        ListFormat format;
+        std::vector<char> buffer;
+        size_t used;
+        bool failed;
+        size_t total;
+};
+
+bool ListWriter::flush(){
+    size_t done = 0;
+    while(done < used && !failed){
+        TRACE_COUNT(TRACE_SYSCALLS, 1);
+        ssize_t n = write(fd, &buffer[done], used - done);
+        if(n < 0 && errno != EINTR){
+            failed = true;
+        } else if(n > 0){
+            done += n;
+        }
+    }
+    total += done;
+    used = 0;
+    return !failed;
+}
+
+//length of the well-formed UTF-8 sequence (RFC 3629: no overlong forms, no
+//surrogates, nothing past U+10FFFF) that starts a multibyte character at
+//text, 0 if there is none
+static size_t utf8Length(const unsigned char *text, size_t left){
+    unsigned char c = text[0];
+    size_t len;
+    unsigned char low = 0x80, high = 0xbf; //range of the second byte
+    if(c >= 0xc2 && c <= 0xdf){
+        len = 2;
+    } else if(c >= 0xe0 && c <= 0xef){
+        len = 3;
+        if(c == 0xe0){
+            low = 0xa0;
+        } else if(c == 0xed){
+            high = 0x9f;
+        }
+    } else if(c >= 0xf0 && c <= 0xf4){
+        len = 4;
+        if(c == 0xf0){
+            low = 0x90;
+        } else if(c == 0xf4){
+            high = 0x8f;
+        }
+    } else {
+        return 0;
+    }
+    if(left < len || text[1] < low || text[1] > high){
+        return 0;
+    }
+    for(size_t i = 2; i < len; i++){
+        if((text[i] & 0xc0) != 0x80){
+            return 0;
+        }
+    }
+    return len;
+}
+
+//names are bytes, only what JSON cannot hold as it is gets escaped. bytes
+//that are not UTF-8 become U+FFFD each, which is shorter than an escape
+void ListWriter::putEscaped(const char *text, size_t len){
+    const unsigned char *bytes = (const unsigned char*)text;
+    for(size_t i = 0; i < len; i++){
+        unsigned char c = bytes[i];
+        if(c == '"' || c == '\\'){
+            buffer[used++] = '\\';
+            buffer[used++] = c;
+        } else if(c < 0x20){
+            used += snprintf(&buffer[used], 7, "\\u%04x", c);
+        } else if(c < 0x80){
+            buffer[used++] = c;
+        } else {
+            size_t n = utf8Length(bytes + i, len - i);
+            if(n == 0){
+                put("\xef\xbf\xbd", 3);
+            } else {
+                put(bytes + i, n);
+                i += n - 1;
+            }
+        }
+    }
+}
+
+//snprintf per field costs more than reading the entry did
+void ListWriter::putNumber(int64_t value){
+    char digits[24];
+    int n = 0;
+    uint64_t left = value < 0 ? -(uint64_t)value : value;
+    do {
+        digits[n++] = '0' + left % 10;
+        left /= 10;
+    } while(left > 0);
+    if(value < 0){
+        buffer[used++] = '-';
+    }
+    while(n > 0){
+        buffer[used++] = digits[--n];
+    }
+}
+
+size_t ListWriter::folder(const TreeNode &node){
+    const EntryStore &list = node.entries;
+    std::string dir = node.path == "/" ? "" : node.path;
+    uint32_t count = 0;
+    for(size_t i = 0; i < list.size(); i++){
+        count += strcmp(list.name(i), "..") != 0;
+    }
+    if(format == LIST_BINARY){
+        uint32_t path_len = node.path.size();
+        room(1 + 2 * sizeof(uint32_t) + path_len);
+        put("D", 1);
+        put(&path_len, sizeof(path_len));
+        put(node.path.data(), path_len);
+        put(&count, sizeof(count));
+    }
+
+    for(size_t i = 0; i < list.size(); i++){
+        const char *name = list.name(i);
+        size_t name_len = list.nameLength(i);
+        if(strcmp(name, "..") == 0){
+            continue;
+        }
+        FileType type = list.type(i);
+        uint64_t bytes = list.fileSize(i);
+        int64_t mtime = list.modifiedTime(i);
+        room(LIST_RECORD_MAX);
+        if(format == LIST_BINARY){
+            uint8_t head[2] = { (uint8_t)type, (uint8_t)list.isLink(i) };
+            uint16_t len = name_len;
+            uint32_t mode = list.mode(i);
+            put(head, sizeof(head));
+            put(&len, sizeof(len));
+            put(&mode, sizeof(mode));
+            put(&bytes, sizeof(bytes));
+            put(&mtime, sizeof(mtime));
+            put(name, name_len);
+            continue;
+        }
+        double size;
+        SizeUnit units;
+        char perms[PERMS_TEXT_SIZE];
+        fitFilesizeToUnit(bytes, &size, &units);
+        perms[0] = '\0';
+        if(type != TYPE_DIRECTORY){ //a folder's own bits are not read, only that it is one
+            setFilePermField(perms, list.mode(i));
+        }
+        put("{\"path\":\"", 9);
+        putEscaped(dir.data(), dir.size());
+        put("/", 1);
+        putEscaped(name, name_len);
+        put("\",\"type\":\"", 10);
+        putText(typeName(type));
+        put("\",\"size\":\"", 10);
+        putNumber((int64_t)size); //whole units, fitFilesizeToUnit truncates
+        put(" ", 1);
+        putText(unitName(units));
+        put("\",\"bytes\":", 10);
+        putNumber(bytes);
+        put(",\"perms\":\"", 10);
+        putText(perms);
+        put("\",\"mtime\":", 10);
+        putNumber(mtime);
+        putText(list.isLink(i) ? ",\"link\":true}\n" : ",\"link\":false}\n");
+    }
+    return count;
+}
+
+bool streamListing(const std::string &path, int max_depth, ListFormat format, int fd, ListTotals *totals){
+    TRACE_SCOPE("streamListing");
+    std::mutex lock;
+    std::condition_variable woken;
+    bool wakes = false;
+    TreeWalker walker([&](){
+        std::lock_guard<std::mutex> guard(lock);
+        wakes = true;
+        woken.notify_one();
+    });
+    walker.setBacklog(LIST_BACKLOG);
+
+    ListWriter writer(fd, format);
+    totals->folders = 0;
+    totals->entries = 0;
+    std::vector<TreeWalker::Result> results;
+    walker.start(path, max_depth, SortOrder());
+    while(true){
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            woken.wait_for(guard, std::chrono::milliseconds(50), [&]{ return wakes; });
+            wakes = false;
+        }
+        bool done = walker.progress().done; //before the poll, so the last nodes are in it
+        walker.poll(&results);
+        for(int i = 0; i < results.size(); i++){
+            if(writer.ok()){
+                totals->entries += writer.folder(*results[i].node);
+                totals->folders++;
+            }
+            delete results[i].node;
+        }
+        if(done || !writer.ok()){
+            break; //a reader that went away stops the walk, the walker cancels it on the way out
+        }
+    }
+    bool ok = writer.flush();
+    totals->bytes = writer.written();
+    return ok;
+}
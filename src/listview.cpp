@@ -0,0 +1,224 @@
+#include <math.h>
+#include "listview.h"
+
+//adds delta to the weight of entry i
+static void fenwickAdd(std::vector<int> *tree, size_t i, int delta){
+    for(size_t k = i + 1; k < tree->size(); k += k & -k){
+        (*tree)[k] += delta;
+    }
+}
+
+//entry holding offset rows in, with offset reduced to the row within it
+static size_t fenwickFind(const std::vector<int> &tree, int *offset){
+    size_t n = tree.size() - 1;
+    size_t step = 1;
+    while(step * 2 <= n){
+        step *= 2;
+    }
+    size_t pos = 0;
+    for(; step > 0; step /= 2){
+        if(pos + step <= n && tree[pos + step] <= *offset){
+            pos += step;
+            *offset -= tree[pos];
+        }
+    }
+    return pos;
+}
+
+//rows the child node behind entry i of node adds under it
+static int childRows(const std::vector<TreeNode> &nodes, int node, size_t i){
+    int child = nodes[node].entries.child(i);
+    if(child <= node || child >= nodes.size()){
+        return 0;
+    }
+    const TreeNode &c = nodes[child];
+    return (c.loaded && c.expanded && c.parent == node) ? c.row_count : 0;
+}
+
+//whether entry i of n has a row of its own, given the rows its child adds
+static int ownRow(const TreeNode &n, size_t i, int child_rows){
+    return (n.shown.size() != n.entries.size() || n.shown[i] || child_rows > 0) ? 1 : 0;
+}
+
+static void buildLayout(std::vector<TreeNode> *nodes, int node){
+    TreeNode *n = &(*nodes)[node];
+    size_t count = n->entries.size();
+    n->row_sums.assign(count + 1, 0);
+    for(size_t k = 1; k <= count; k++){
+        int child_rows = childRows(*nodes, node, k - 1);
+        n->row_sums[k] += ownRow(*n, k - 1, child_rows) + child_rows;
+        size_t up = k + (k & -k);
+        if(up <= count){
+            n->row_sums[up] += n->row_sums[k];
+        }
+    }
+    n->row_count = 0;
+    for(size_t k = count; k > 0; k -= k & -k){
+        n->row_count += n->row_sums[k];
+    }
+}
+
+//the rows node adds under its parent entry went from old_rows to new_rows,
+//every expanded ancestor changes with it. under a filter the parent entry
+//itself may appear or vanish along the way.
+static void propagate(std::vector<TreeNode> *nodes, int node, int old_rows, int new_rows){
+    while(old_rows != new_rows){
+        const TreeNode &n = (*nodes)[node];
+        if(n.parent < 0){
+            return;
+        }
+        TreeNode *p = &(*nodes)[n.parent];
+        if(!p->loaded || n.parent_entry < 0 || n.parent_entry >= p->entries.size()
+           || p->entries.child(n.parent_entry) != node){
+            return; //parent not in yet (or relisted), it counts us when it is laid out
+        }
+        int before = ownRow(*p, n.parent_entry, old_rows) + old_rows;
+        int after = ownRow(*p, n.parent_entry, new_rows) + new_rows;
+        int old_count = p->row_count;
+        fenwickAdd(&p->row_sums, n.parent_entry, after - before);
+        p->row_count += after - before;
+        old_rows = p->expanded ? old_count : 0;
+        new_rows = p->expanded ? p->row_count : 0;
+        node = n.parent;
+    }
+}
+
+void linkChildren(std::vector<TreeNode> *nodes, int node){
+    for(size_t i = 0; i < (*nodes)[node].entries.size(); i++){
+        int child = (*nodes)[node].entries.child(i);
+        if(child <= node){
+            continue;
+        }
+        if(child >= nodes->size()){
+            nodes->resize(child + 1);
+        }
+        TreeNode *c = &(*nodes)[child];
+        c->parent_entry = i;
+        if(!c->loaded){
+            c->parent = node;
+        }
+    }
+}
+
+void layoutNode(std::vector<TreeNode> *nodes, int node){
+    int old_count = (*nodes)[node].row_count;
+    buildLayout(nodes, node);
+    if((*nodes)[node].expanded){
+        propagate(nodes, node, old_count, (*nodes)[node].row_count);
+    }
+}
+
+void layoutTree(std::vector<TreeNode> *nodes){
+    for(int node = (int)nodes->size() - 1; node >= 0; node--){
+        if((*nodes)[node].loaded){
+            buildLayout(nodes, node);
+        }
+    }
+}
+
+void setExpanded(std::vector<TreeNode> *nodes, int node, bool expanded){
+    TreeNode *n = &(*nodes)[node];
+    if(n->expanded == expanded){
+        return;
+    }
+    n->expanded = expanded;
+    int rows = n->row_count;
+    propagate(nodes, node, expanded ? 0 : rows, expanded ? rows : 0);
+}
+
+void filterNode(std::vector<TreeNode> *nodes, int node, const std::string &query){
+    TreeNode *n = &(*nodes)[node];
+    if(query.empty()){
+        n->shown.clear();
+        n->index.clear(); //memory back, the next filter rebuilds it anyway
+        return;
+    }
+    std::vector<uint32_t> matches;
+    n->index.match(n->entries, query, &matches);
+    n->shown.assign(n->entries.size(), 0);
+    for(size_t k = 0; k < matches.size(); k++){
+        n->shown[matches[k]] = 1;
+    }
+}
+
+void prepareFilter(std::vector<TreeNode> *nodes, int node){
+    (*nodes)[node].index.prepare((*nodes)[node].entries);
+}
+
+int rowCount(const std::vector<TreeNode> &nodes){
+    return (nodes.empty() || !nodes[0].loaded) ? 0 : nodes[0].row_count;
+}
+
+RowRef findRow(const std::vector<TreeNode> &nodes, int r){
+    RowRef row;
+    row.node = 0;
+    row.depth = 0;
+    while(true){
+        const TreeNode &n = nodes[row.node];
+        int offset = r;
+        row.index = fenwickFind(n.row_sums, &offset);
+        if(offset == 0 || row.index >= n.entries.size()){
+            return row;
+        }
+        //inside the subtree hanging off this entry
+        row.node = n.entries.child(row.index);
+        row.depth++;
+        r = offset - 1;
+    }
+}
+
+void visibleRows(int row_count, int scroll_y, int view_h, int *first, int *last){
+    *first = scroll_y / ROW_HEIGHT - ROW_OVERSCAN;
+    *last = (scroll_y + view_h + ROW_HEIGHT - 1) / ROW_HEIGHT + ROW_OVERSCAN;
+    if(*first < 0){
+        *first = 0;
+    }
+    if(*last > row_count){
+        *last = row_count;
+    }
+    if(*first > *last){
+        *first = *last;
+    }
+}
+
+int rowAt(int row_count, int scroll_y, int y){
+    if(y + scroll_y < 0){
+        return -1;
+    }
+    int row = (y + scroll_y) / ROW_HEIGHT;
+    if(row >= row_count){
+        return -1;
+    }
+    return row;
+}
+
+void scrollTo(ScrollState *scroll, float target, int content_h, int view_h){
+    float max_y = content_h - view_h;
+    if(target > max_y){
+        target = max_y;
+    }
+    if(target < 0){
+        target = 0;
+    }
+    scroll->target = target;
+}
+
+void scrollBy(ScrollState *scroll, float delta, int content_h, int view_h){
+    scrollTo(scroll, scroll->target + delta, content_h, view_h);
+}
+
+void scrollReset(ScrollState *scroll){
+    scroll->y = 0;
+    scroll->target = 0;
+}
+
+void scrollStep(ScrollState *scroll, unsigned elapsed_ms){
+    float remaining = scroll->target - scroll->y;
+    if(fabsf(remaining) < 1.0f){
+        scroll->y = scroll->target; //close enough, stop animating
+        return;
+    }
+    //frame-rate independent easing: SCROLL_EASE of the way per 16ms
+    float k = 1.0f - powf(1.0f - SCROLL_EASE, elapsed_ms / 16.0f);
+    scroll->y += remaining * k;
+}
@@ -1,7 +1,11 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <set>
 #include <algorithm>
+#include <utility>
+#include <chrono>
+#include <climits>
 #include <dirent.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -9,10 +13,29 @@
 #include <SDL.h>
 #include <SDL_image.h>
 #include <SDL_ttf.h>
-#include <sstream>
+#include <string.h>
+#include "entrystore.h"
+#include "filetypes.h"
+#include "scanworker.h"
+#include "treewalker.h"
+#include "dirwatcher.h"
+#include "metacache.h"
+#include "foldersizer.h"
+#include "thumbnails.h"
+#include "launcher.h"
+#include "lister.h"
+#include "resourcepool.h"
+#include "trace.h"
+#include "glyphatlas.h"
+#include "iconcache.h"
+#include "framecache.h"
+#include "listview.h"
 
 #define WIDTH 800
 #define HEIGHT 600
+#define FRAME_MS 16        //longest we want a single event loop iteration to take
+#define WHEEL_STEP 72      //pixels per wheel notch (3 rows)
+#define TREE_DEPTH 32      //default levels the recursive view opens, --depth N overrides
 
 //STEPS
 //store current directory (start at HOME)
@@ -22,78 +45,187 @@
 //all SDL functionality (one click opens file, scroll bar or other concatenation, info columns)
 //recursive viewer (tree expansion of subdirectories) with toggle
 
-class FileData { //basic file info
-    public:
-        SDL_Texture *text_texture;
-        SDL_Texture *icon_texture;
-        SDL_Texture *size_texture;
-        SDL_Texture *permissions_texture;
-        SDL_Rect text_rect;
-        SDL_Rect icon_rect;
-        SDL_Rect size_rect;
-        SDL_Rect permissions_rect;
-
-        std::string filename;
-        std::string type;
-        std::string path;
-        double size;
-        std::string perms;
-        std::string units;
-        int child_index; 
-} ;
+//display text of one on-screen row, pointing into the store for the name
+typedef struct RowText {
+    RowRef row;
+    const char *disclosure; //"+" or "-" in front of a folder that can be opened, else NULL
+    const char *name;
+    size_t name_len;
+    int name_w;
+    uint32_t name_hash;     //to tell a row from the one drawn before, the name may have moved
+    IconId icon;
+    bool is_dir;
+    bool selected;
+    bool thumbnail;         //an image drawn as a preview
+    char size[32];
+    char perms[PERMS_TEXT_SIZE];
+} RowText;
+
+//a bar or box drawn over the rows, kept to see whether the next frame changes it
+typedef struct Overlay {
+    SDL_Rect rect;
+    SDL_Color color;
+    std::vector<std::string> lines;
+} Overlay;
 
 typedef struct AppData {
     std::string current_dir;
-    std::vector<std::vector<FileData>> file_entries;
-    TTF_Font *font;
+    std::vector<TreeNode> nodes;        //nodes[0] is current_dir, the rest are opened folders, laid out by listview
+    std::vector<RowText> visible;       //text of the rows on screen, rebuilt whenever the view may have changed
+    FrameCache *frame;        //what is on screen, only what changed is drawn again
+    bool view_stale;          //something happened that may change what is shown, render() compares
+    std::vector<RowText> drawn;         //the rows as the frame shows them
+    int drawn_first_row;
+    int drawn_offset;
+    int drawn_column;
+    std::vector<Overlay> drawn_overlays;
+    bool thumbs_changed;      //previews arrived (or are still being decoded) since the last frame
+    ResourcePool *resources;  //every texture and font below comes from here
+    bool show_resources;      //F12, what the pool holds
+    bool show_trace;          //F3, what the last frame cost (TRACE=1 builds)
+    TraceFrame trace_frame;
+    GlyphAtlas *atlas;
     int text_column_offset;
-    SDL_Texture *help_text;
-    SDL_Texture *recur_texture;
-    SDL_Texture *ust_texture;
+    IconCache *icons;
+    IconId help_icon;
+    IconId recur_icon;
+    IconId ust_icon;
     SDL_Rect recur_rect;
     SDL_Rect help_rect;
     SDL_Rect ust_rect;
     bool recursion_switch;
+    ScanWorker *scan_worker;
+    unsigned scan_generation; //batches from older scans are dropped
+    bool scanning;            //current folder is still being read
+    TreeWalker *tree_walker;
+    unsigned tree_generation;
+    bool walking;             //recursive view is still being expanded
+    int tree_depth;
+    DirWatcher *watcher;
+    unsigned watch_generation;
+    std::vector<FolderChanges> held_changes; //for folders still being read
+    MetaCache *cache;         //NULL with --no-cache
+    DirStamp scan_stamp;      //current_dir as it was when the scan started
+    bool scan_stamped;
+    bool revalidating;        //root shows the cached listing until the scan is complete
+    FolderSizer *sizer;
+    bool du_mode;             //folders show what they hold on disk
+    ThumbnailCache *thumbs;
+    bool thumbnails;          //images show a preview instead of their icon
+    Launcher *launcher;       //opens files, reaped every frame
+    std::set<std::string> selected; //ctrl+click, Enter opens them all at once
+    std::string filter;       //only rows whose name contains this are shown
+    bool typing_filter;       //the filter bar has the keyboard
+    size_t filter_matches;
+    double filter_ms;         //what the last keystroke cost
+    ScrollState scroll;       //applied when drawing, rows themselves never move
+    SortOrder sort_order;     //every node is kept in this order
 } AppData;
 
-void initialize(SDL_Renderer *renderer, AppData *data_ptr, int list_index, int parent_index, int parent_vect_index, int y_parent, int indentation);
+void initialize(AppData *data_ptr, int first_row, int last_row);
+void handleEvent(SDL_Renderer *renderer, AppData *data_ptr, SDL_Event *event);
+void openDirectory(AppData *data_ptr);
+void openFiles(AppData *data_ptr, const std::vector<std::string> &paths);
+void collectLaunches(AppData *data_ptr);
+void collectScanResults(AppData *data_ptr);
 void static_init(SDL_Renderer *renderer, AppData *data_ptr);
-void startRecursion(SDL_Renderer *renderer, AppData *data_ptr, int root_index, int start_from);
+void collectTreeResults(AppData *data_ptr);
+void toggleFolder(AppData *data_ptr, const RowRef &row);
+void collectWatchChanges(AppData *data_ptr);
+void dropNode(AppData *data_ptr, int node);
+void relayout(AppData *data_ptr, int node);
+void openFilter(AppData *data_ptr);
+void setFilter(AppData *data_ptr, const std::string &text);
+bool editFilter(AppData *data_ptr, const SDL_Keysym &key);
+SortOrder sortBy(SortOrder order, SortKey key);
+void sortListing(AppData *data_ptr, const SortOrder &order);
 void recursiveInit(SDL_Renderer *renderer, AppData *data_ptr, int list_index);
 void render(SDL_Renderer *renderer, AppData *dt);
-void updateFileList(std::vector<FileData> *files, std::string filepath, bool recur);
-void fitFilesizeToUnit(FileData *file);
-void setFilePermField(FileData *file, struct stat *filestats);
-void convertToUsableType(FileData *file);
-
-bool compareFunction (const FileData &a, const FileData &b) 
-{
-    std::string _a = a.filename;
-    std::string _b = b.filename;
-    transform(_a.begin(), _a.end(), _a.begin(), ::tolower);
-    transform(_b.begin(), _b.end(), _b.begin(), ::tolower);
-
-    //std::cout << _a << " " << _b << '\n';
-
-    return _a < _b;
-} 
+bool changesView(AppData *data_ptr, const SDL_Event *event);
+void soakTest(SDL_Renderer *renderer, AppData *data_ptr, int rounds);
 
 int main(int argc, char **argv)
 {
     AppData dt;
     char *home = getenv("HOME");
     dt.current_dir = home;
-    printf("HOME: %s\n", home);
     int filesys_idx = 0;
-    std::vector<FileData> first;
-    dt.file_entries.push_back(first);
-    updateFileList(&dt.file_entries[0], home, false);
+    dt.nodes.push_back(TreeNode());
     dt.text_column_offset = 0;
     dt.recursion_switch = false;
+    dt.scanning = false;
+    dt.walking = false;
+    dt.tree_depth = TREE_DEPTH;
+    dt.cache = NULL;
+    dt.scan_stamped = false;
+    dt.revalidating = false;
+    dt.du_mode = false;
+    dt.thumbnails = false;
+    dt.show_resources = false;
+    dt.show_trace = false;
+    dt.trace_frame.scopes = 0;
+    dt.typing_filter = false;
+    dt.filter_matches = 0;
+    dt.filter_ms = 0;
+    dt.view_stale = true;
+    dt.drawn_first_row = -1;
+    dt.drawn_offset = 0;
+    dt.drawn_column = 0;
+    dt.thumbs_changed = false;
+    bool use_cache = true;
+    size_t texture_budget = RESOURCE_BUDGET_BYTES;
+    int soak_rounds = 0;
+    std::string trace_file;
+    bool listing = false;     //--list and --tree write to stdout, no window
+    bool list_tree = false;
+    bool depth_given = false;
+    std::string list_path = ".";
+    ListFormat list_format = LIST_NDJSON;
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--depth") == 0 && i + 1 < argc){
+            dt.tree_depth = atoi(argv[i + 1]);
+            depth_given = true;
+        } else if(strcmp(argv[i], "--list") == 0 || strcmp(argv[i], "--tree") == 0){
+            listing = true;
+            list_tree = strcmp(argv[i], "--tree") == 0;
+            if(i + 1 < argc && argv[i + 1][0] != '-'){
+                list_path = argv[i + 1];
+            }
+        } else if(strcmp(argv[i], "--binary") == 0){
+            list_format = LIST_BINARY;
+        } else if(strcmp(argv[i], "--no-cache") == 0){
+            use_cache = false;
+        } else if(strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc){
+            texture_budget = (size_t)atoi(argv[i + 1]) << 20;
+        } else if(strcmp(argv[i], "--soak") == 0 && i + 1 < argc){
+            soak_rounds = atoi(argv[i + 1]);
+        } else if(strcmp(argv[i], "--trace") == 0 && i + 1 < argc){
+            trace_file = argv[i + 1];
+            if(!traceBuilt()){
+                fprintf(stderr, "--trace needs a build with TRACE=1\n");
+            }
+        }
+    }
+    loadFileTypes(fileTypesFile()); //before anything is read, the workers classify too
+
+    //the whole tree unless --depth says otherwise, the window's default is for what fits on screen
+    if(listing){
+        ListTotals totals;
+        int depth = !list_tree ? 0 : depth_given ? dt.tree_depth : INT_MAX;
+        if(!streamListing(list_path, depth, list_format, STDOUT_FILENO, &totals)){
+            perror("writing the listing");
+            return 1;
+        }
+        return 0;
+    }
+    printf("HOME: %s\n", home);
+    if(use_cache){
+        dt.cache = new MetaCache(MetaCache::cacheFile());
+    }
 
     // initializing SDL as Video
     SDL_Init(SDL_INIT_VIDEO);
-    IMG_Init(IMG_INIT_PNG);
+    IMG_Init(IMG_INIT_PNG | IMG_INIT_JPG | IMG_INIT_TIF | IMG_INIT_WEBP);
     TTF_Init();
 
     // create window and renderer
@@ -101,117 +233,121 @@ int main(int argc, char **argv)
     SDL_Window *window;
     SDL_CreateWindowAndRenderer(WIDTH, HEIGHT, 0, &window, &renderer);
 
+    // all text is drawn from one glyph atlas
+    dt.resources = new ResourcePool(texture_budget);
+    dt.frame = new FrameCache(dt.resources, WIDTH, HEIGHT);
+    SDL_Color text_color = { 0, 0, 0, 255 };
+    dt.atlas = new GlyphAtlas(dt.resources);
+    if(!dt.atlas->load(renderer, "resrc/OpenSans-Regular.ttf", 20, text_color)){
+        fprintf(stderr, "could not load resrc/OpenSans-Regular.ttf: %s\n", TTF_GetError());
+        return 1;
+    }
+
+    // every icon is decoded once, into one texture
+    dt.icons = new IconCache(dt.resources);
+    dt.icons->load(renderer, "resrc/images");
+
+    // folders are read on a worker thread, which wakes the event loop when a batch is ready
+    Uint32 scan_event = SDL_RegisterEvents(1);
+    std::function<void()> wake_loop = [scan_event](){
+        SDL_Event wake;
+        SDL_zero(wake);
+        wake.type = scan_event;
+        SDL_PushEvent(&wake);
+    };
+    dt.scan_worker = new ScanWorker(wake_loop);
+    dt.tree_walker = new TreeWalker(wake_loop);
+    dt.watcher = new DirWatcher(wake_loop);
+    dt.sizer = new FolderSizer(wake_loop);
+    dt.thumbs = new ThumbnailCache(dt.resources, wake_loop);
+    dt.thumbs->setPersist(use_cache);
+    dt.launcher = new Launcher(wake_loop);
+    SDL_StopTextInput(); //on by default, only the filter bar takes text
+    openDirectory(&dt);
+
     // initialize and perform rendering loop
-    initialize(renderer, &dt, 0, 0, 0, 0, 0);
     static_init(renderer, &dt);
     render(renderer, &dt);
     SDL_Event event;
-    SDL_WaitEvent(&event);
 
     int rendercount = 0;
-    while (event.type != SDL_QUIT)
+    bool running = true;
+    if(soak_rounds > 0){
+        soakTest(renderer, &dt, soak_rounds);
+        running = false;
+    }
+    Uint32 last_frame = SDL_GetTicks();
+    while (running)
     {
+        //while a folder is loading or the list is still gliding, keep the loop ticking
+        bool got_event;
+        if(dt.scanning || dt.walking || dt.scroll.moving() || (dt.du_mode && dt.sizer->busy()) ||
+           (dt.thumbnails && dt.thumbs->busy())){
+            got_event = SDL_WaitEventTimeout(&event, FRAME_MS);
+            dt.view_stale = true;
+        } else {
+            got_event = SDL_WaitEvent(&event);
+        }
 
-        //render(renderer);
-        SDL_WaitEvent(&event);
-        if(event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_LEFT){
-            int y_clicked = event.button.y; //keep in mind that this is 'from the top' y, so inverted
-            int x_clicked = event.button.x; //width on page from left
-            
-            if(y_clicked < HEIGHT && x_clicked < WIDTH){
-                for(int i = 0; i < dt.file_entries[0].size(); i++){
-                    FileData file = dt.file_entries[0][i];
-                    int lowx = file.icon_rect.x;
-                    int lowy = file.icon_rect.y;
-                    int highx = file.text_rect.x + file.text_rect.w;
-                    int highy = file.text_rect.y + file.text_rect.h;
-                    
-                    if(y_clicked > lowy && y_clicked < highy
-                        && x_clicked > lowx && x_clicked < highx) //clicked in region
-                    {
-                        if(file.type == "directory"){
-                            if(file.filename != ".."){
-                                dt.current_dir += "/" + file.filename;
-                                updateFileList(&dt.file_entries[0], const_cast<char*>(dt.current_dir.c_str()), false);
-                                initialize(renderer, &dt, 0, 0, 0, 0, 0);
-                            }else{
-                                size_t found = dt.current_dir.find_last_of("/");
-                                if(found != std::string::npos){
-                                    dt.current_dir = dt.current_dir.substr(0, found); 
-                                    if(dt.current_dir.empty()){
-                                        dt.current_dir += "/";
-                                    }
-                                }
-                                updateFileList(&dt.file_entries[0], const_cast<char*>(dt.current_dir.c_str()), false);
-                                initialize(renderer, &dt, 0, 0, 0, 0, 0);
-                            }
-                        } else {
-                            int pid = fork();
-                            if(pid == 0){ 
-                                std::string filepath = dt.current_dir + "/" + file.filename; 
-                                char *const argv_list[] = {"xdg-open", const_cast<char*>(filepath.c_str()), NULL} ;
-                                execvp("xdg-open", argv_list);
-                            }
-                        }
-                    } 
-                }
-            }
-
+        //what the last frame cost, for the overlay
+        traceFrame(&dt.trace_frame);
+        TRACE_SCOPE("frame");
 
-            //CHECK FOR RECURSION TOGGLE
-            if(y_clicked >= dt.recur_rect.y && y_clicked <= dt.recur_rect.y + dt.recur_rect.h 
-                && x_clicked >= dt.recur_rect.x && x_clicked <= dt.recur_rect.x + dt.recur_rect.w ){
-                    if(dt.recursion_switch){
-                        dt.recursion_switch = false;
-                        dt.file_entries.clear();
-                        std::vector<FileData> nv;
-                        dt.file_entries.push_back(nv);
-                        updateFileList(&dt.file_entries[0], dt.current_dir, false);
-                        initialize(renderer, &dt, 0, 0, 0, 0, 0);
-                    } else {
-                        dt.recursion_switch = true;   
-                        int size_start = dt.file_entries.size();
-                        startRecursion(renderer, &dt, 0, 1);  
-                        int to_recur = dt.file_entries.size() - size_start;
-                        for(int i = size_start; i < to_recur; i++){
-                            startRecursion(renderer, &dt, i, dt.file_entries.size());  
-                        }    
-                                
-                    }
-                static_init(renderer, &dt);
-               //std::co << "caught recur switch?\n";
+        //handle everything that piled up (key repeat, wheel bursts) and draw once
+        while(got_event){
+            if(event.type == SDL_QUIT){
+                running = false;
             }
-
+            if(changesView(&dt, &event)){
+                dt.view_stale = true;
+            }
+            handleEvent(renderer, &dt, &event);
+            got_event = SDL_PollEvent(&event);
         }
 
-        if(event.type == SDL_KEYDOWN){ //arrow keys to scroll through entries
-            //std::cout << "BACK OF ROOT POS: " << dt.file_entries[0].back().icon_rect.y << '\n';
-            if(event.key.keysym.scancode == SDL_SCANCODE_DOWN && dt.file_entries[0].back().icon_rect.y >= HEIGHT){
-                for(int i = 0; i < dt.file_entries.size(); i++){
-                    for(int j = 0; j < dt.file_entries[i].size(); j++){
-                        dt.file_entries[i][j].icon_rect.y -= HEIGHT;
-                        dt.file_entries[i][j].text_rect.y -= HEIGHT;
-                        dt.file_entries[i][j].permissions_rect.y -= HEIGHT;
-                        dt.file_entries[i][j].size_rect.y -= HEIGHT;
-                    }
-                }
-            }
-            if(event.key.keysym.scancode == SDL_SCANCODE_UP && dt.file_entries[0].front().icon_rect.y < 0){
-                for(int i = 0; i < dt.file_entries.size(); i++){
-                    for(int j = 0; j < dt.file_entries[i].size(); j++){
-                        dt.file_entries[i][j].icon_rect.y += HEIGHT;
-                        dt.file_entries[i][j].text_rect.y += HEIGHT;
-                        dt.file_entries[i][j].permissions_rect.y += HEIGHT;
-                        dt.file_entries[i][j].size_rect.y += HEIGHT;
-                    }
-                }
-            }
+        //bring in whatever the scanner found, a frame's worth at a time
+        if(dt.scanning){
+            collectScanResults(&dt);
+        }
+        if(dt.walking){
+            collectTreeResults(&dt);
+        }
+        collectWatchChanges(&dt);
+        collectLaunches(&dt);
+        dt.thumbs_changed = dt.thumbs->upload(renderer) > 0 || (dt.thumbnails && dt.thumbs->busy());
+        Uint32 now = SDL_GetTicks();
+        Uint32 elapsed = now - last_frame;
+        if(elapsed > FRAME_MS){
+            elapsed = FRAME_MS; //we were idle, start the glide from its first step
         }
+        scrollStep(&dt.scroll, elapsed);
+        last_frame = now;
         rendercount++;
         render(renderer, &dt);
     }
 
     // clean up
+    if(!trace_file.empty() && traceBuilt()){
+        if(traceWrite(trace_file)){
+            printf("trace written to %s\n", trace_file.c_str());
+        } else {
+            perror(trace_file.c_str());
+        }
+    }
+    delete dt.scan_worker;
+    delete dt.tree_walker;
+    delete dt.watcher;
+    delete dt.sizer;
+    delete dt.thumbs;
+    delete dt.launcher;
+    if(dt.cache != NULL){
+        dt.cache->save();
+        delete dt.cache;
+    }
+    delete dt.frame;
+    delete dt.atlas;
+    delete dt.icons;
+    delete dt.resources; //after everything that holds its handles
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
@@ -221,355 +357,911 @@ int main(int argc, char **argv)
     return 0;
 }
 
-void initialize(SDL_Renderer *renderer, AppData *data_ptr, int list_index, int parent_index, int parent_vect_index, int y_parent, int indent)
+void handleEvent(SDL_Renderer *renderer, AppData *data_ptr, SDL_Event *event)
 {
-    data_ptr->font = TTF_OpenFont("resrc/OpenSans-Regular.ttf", 20);
-    SDL_Color color = { 0, 0, 0 };
-    for(int i = 0; i < data_ptr->file_entries[list_index].size(); i++) {
+    if(event->type == SDL_MOUSEBUTTONDOWN && event->button.button == SDL_BUTTON_LEFT){
+        int y_clicked = event->button.y; //keep in mind that this is 'from the top' y, so inverted
+        int x_clicked = event->button.x; //width on page from left
         
-        //name, create texture and init the x y w h
-        const char* filename = data_ptr->file_entries[list_index][i].filename.c_str();
-        SDL_Surface *text_surf = TTF_RenderText_Solid(data_ptr->font, filename, color);
-        data_ptr->file_entries[list_index][i].text_texture = SDL_CreateTextureFromSurface(renderer, text_surf);
-        SDL_FreeSurface(text_surf);
-        data_ptr->file_entries[list_index][i].text_rect.x = 50 + indent;
-        data_ptr->file_entries[list_index][i].text_rect.y = y_parent + (i * 24);
-        SDL_Rect hold = data_ptr->file_entries[list_index][i].text_rect;
-        SDL_QueryTexture(data_ptr->file_entries[list_index][i].text_texture, NULL, NULL, &(data_ptr->file_entries[list_index][i].text_rect.w), &(data_ptr->file_entries[list_index][i].text_rect.h));
-
-        if(data_ptr->file_entries[list_index][i].text_rect.w> data_ptr->text_column_offset){
-            data_ptr->text_column_offset = data_ptr->file_entries[list_index][i].text_rect.w;
-        }
-
-        //icon, create texture and init the x y w h
-        SDL_Surface *icon_surf;
-        if (data_ptr->file_entries[list_index][i].type == "directory") {
-            icon_surf = IMG_Load("resrc/images/dir.png");
-        }else if(data_ptr->file_entries[list_index][i].type == "executable") {
-            icon_surf = IMG_Load("resrc/images/exe.png");
-        }else if(data_ptr->file_entries[list_index][i].type == "image") {
-            icon_surf = IMG_Load("resrc/images/img.png");
-        }else if(data_ptr->file_entries[list_index][i].type == "video") {
-            icon_surf = IMG_Load("resrc/images/vid.png");
-        }else if(data_ptr->file_entries[list_index][i].type == "code") {
-            icon_surf = IMG_Load("resrc/images/code.png");
-        }else if(data_ptr->file_entries[list_index][i].type == "other") {
-            icon_surf = IMG_Load("resrc/images/oth.png");
-        }
-
-        data_ptr->file_entries[list_index][i].icon_texture = SDL_CreateTextureFromSurface(renderer, icon_surf);
-        SDL_FreeSurface(icon_surf);
-        data_ptr->file_entries[list_index][i].icon_rect.x = 24 + indent;
-        data_ptr->file_entries[list_index][i].icon_rect.y = y_parent + (i * 24);
-        data_ptr->file_entries[list_index][i].icon_rect.w = 24;
-        data_ptr->file_entries[list_index][i].icon_rect.h = 24;
-       //SDL_QueryTexture(data_ptr->file_entries[list_index][i].icon_texture, NULL, NULL, &(data_ptr->file_entries[list_index][i].icon_rect.w), &(data_ptr->file_entries[list_index][i].icon_rect.h));
+        int row = rowAt(rowCount(data_ptr->nodes), data_ptr->scroll.offset(), y_clicked);
+        if(y_clicked < HEIGHT && x_clicked < WIDTH && row >= 0){
+            RowRef ref = findRow(data_ptr->nodes, row);
+            const TreeNode &node = data_ptr->nodes[ref.node];
+            int index = ref.index;
+            std::string filename = node.entries.name(index);
+            FileType type = node.entries.type(index);
+            std::string dir = node.path;
+            int indent = ref.depth * ROW_INDENT;
+            int lowx = 24 + indent;
+            int highx = 50 + indent + data_ptr->atlas->measure(filename.c_str(), filename.size());
+
+            if(x_clicked > indent && x_clicked <= lowx) //the +/- in front of a folder
+            {
+                toggleFolder(data_ptr, ref);
+            }
+            else if(x_clicked > lowx && x_clicked < highx) //clicked in region
+            {
+                if(type == TYPE_DIRECTORY){
+                    if(filename != ".."){
+                        data_ptr->current_dir = dir + "/" + filename;
+                    }else{
+                        data_ptr->current_dir = dir;
+                        size_t found = data_ptr->current_dir.find_last_of("/");
+                        if(found != std::string::npos){
+                            data_ptr->current_dir = data_ptr->current_dir.substr(0, found); 
+                            if(data_ptr->current_dir.empty()){
+                                data_ptr->current_dir += "/";
+                            }
+                        }
+                    }
+                    openDirectory(data_ptr);
+                    static_init(renderer, data_ptr);
+                } else {
+                    std::string filepath = (dir == "/" ? "" : dir) + "/" + filename;
+                    if(SDL_GetModState() & KMOD_CTRL){ //picks it for Enter instead
+                        if(data_ptr->selected.erase(filepath) == 0){
+                            data_ptr->selected.insert(filepath);
+                        }
+                    } else {
+                        openFiles(data_ptr, std::vector<std::string>(1, filepath));
+                    }
+                }
+            } 
+        }
+
+
+        //CHECK FOR RECURSION TOGGLE
+        if(y_clicked >= data_ptr->recur_rect.y && y_clicked <= data_ptr->recur_rect.y + data_ptr->recur_rect.h 
+            && x_clicked >= data_ptr->recur_rect.x && x_clicked <= data_ptr->recur_rect.x + data_ptr->recur_rect.w ){
+                if(data_ptr->recursion_switch){
+                    openDirectory(data_ptr);
+                } else if(data_ptr->scanning){
+                    //folder is still loading, expanding a partial listing would miss entries
+                } else {
+                    //the listing stays up while the walker reads the tree again
+                    //from the top, nodes replace it as they come in
+                    TRACE_SCOPE("startRecursion");
+                    data_ptr->recursion_switch = true;
+                    data_ptr->nodes.resize(1);
+                    data_ptr->watch_generation = data_ptr->watcher->clear(); //node numbers start over
+                    data_ptr->watcher->watch(0, data_ptr->current_dir);
+                    for(size_t i = 0; i < data_ptr->nodes[0].entries.size(); i++){
+                        data_ptr->nodes[0].entries.setChild(i, -1);
+                    }
+                    relayout(data_ptr, 0);
+                    data_ptr->tree_generation = data_ptr->tree_walker->start(data_ptr->current_dir, data_ptr->tree_depth, data_ptr->sort_order);
+                    data_ptr->walking = true;
+                }
+            static_init(renderer, data_ptr);
+           //std::co << "caught recur switch?\n";
+        }
+
     }
-    
 
-    //handle permissions and sizes, if needed
-    if(!data_ptr->recursion_switch){
-        for(int i = 0; i < data_ptr->file_entries[list_index].size(); i++) { 
-            if (!(data_ptr->file_entries[list_index][i].type == "directory")) { //if it is a file, sizes
-                FileData cur = data_ptr->file_entries[list_index][i];
-                std::stringstream stream;
-                stream << data_ptr->file_entries[list_index][i].size;
-                std::string fsize = stream.str() + " " + cur.units;
-
-                SDL_Surface *size_surf = TTF_RenderText_Solid(data_ptr->font, fsize.c_str(), color);
-                data_ptr->file_entries[list_index][i].size_texture = SDL_CreateTextureFromSurface(renderer, size_surf);
-                SDL_FreeSurface(size_surf);
-                data_ptr->file_entries[list_index][i].size_rect.x = 100 + data_ptr->text_column_offset;
-                data_ptr->file_entries[list_index][i].size_rect.y = i * 24;
-                SDL_Rect hold = data_ptr->file_entries[list_index][i].size_rect;
-                SDL_QueryTexture(data_ptr->file_entries[list_index][i].size_texture, NULL, NULL, &(data_ptr->file_entries[list_index][i].size_rect.w), &(data_ptr->file_entries[list_index][i].size_rect.h));
-
-                SDL_Surface *perm_surf = TTF_RenderText_Solid(data_ptr->font, cur.perms.c_str(), color);
-                data_ptr->file_entries[list_index][i].permissions_texture = SDL_CreateTextureFromSurface(renderer, perm_surf);
-                SDL_FreeSurface(perm_surf);
-                data_ptr->file_entries[list_index][i].permissions_rect.x = 250 + data_ptr->text_column_offset;
-                data_ptr->file_entries[list_index][i].permissions_rect.y = i * 24;
-                SDL_Rect permhold = data_ptr->file_entries[list_index][i].permissions_rect;
-                SDL_QueryTexture(data_ptr->file_entries[list_index][i].permissions_texture, NULL, NULL, &(data_ptr->file_entries[list_index][i].permissions_rect.w), &(data_ptr->file_entries[list_index][i].permissions_rect.h));
+    if(event->type == SDL_TEXTINPUT && data_ptr->typing_filter){
+        setFilter(data_ptr, data_ptr->filter + event->text.text);
+        return;
+    }
+    if(event->type == SDL_KEYDOWN && data_ptr->typing_filter && editFilter(data_ptr, event->key.keysym)){
+        return;
+    }
 
+    if(event->type == SDL_KEYDOWN){ //keys scroll through entries, repeats included
+        int list_height = rowCount(data_ptr->nodes) * ROW_HEIGHT;
+        switch(event->key.keysym.scancode){
+            case SDL_SCANCODE_DOWN:
+                scrollBy(&data_ptr->scroll, ROW_HEIGHT, list_height, HEIGHT);
+                break;
+            case SDL_SCANCODE_UP:
+                scrollBy(&data_ptr->scroll, -ROW_HEIGHT, list_height, HEIGHT);
+                break;
+            case SDL_SCANCODE_PAGEDOWN:
+                scrollBy(&data_ptr->scroll, HEIGHT - ROW_HEIGHT, list_height, HEIGHT);
+                break;
+            case SDL_SCANCODE_PAGEUP:
+                scrollBy(&data_ptr->scroll, -(HEIGHT - ROW_HEIGHT), list_height, HEIGHT);
+                break;
+            case SDL_SCANCODE_HOME:
+                scrollTo(&data_ptr->scroll, 0, list_height, HEIGHT);
+                break;
+            case SDL_SCANCODE_END:
+                scrollTo(&data_ptr->scroll, list_height, list_height, HEIGHT);
+                break;
+            case SDL_SCANCODE_N: //sort by name, again to reverse
+                sortListing(data_ptr, sortBy(data_ptr->sort_order, SORT_NAME));
+                break;
+            case SDL_SCANCODE_S:
+                sortListing(data_ptr, sortBy(data_ptr->sort_order, SORT_SIZE));
+                break;
+            case SDL_SCANCODE_M:
+                sortListing(data_ptr, sortBy(data_ptr->sort_order, SORT_MTIME));
+                break;
+            case SDL_SCANCODE_T:
+                sortListing(data_ptr, sortBy(data_ptr->sort_order, SORT_TYPE));
+                break;
+            case SDL_SCANCODE_G: { //natural numbers on/off
+                SortOrder order = data_ptr->sort_order;
+                order.natural = !order.natural;
+                sortListing(data_ptr, order);
+                break;
             }
+            case SDL_SCANCODE_SLASH: //filter bar
+                openFilter(data_ptr);
+                break;
+            case SDL_SCANCODE_F:
+                if(event->key.keysym.mod & KMOD_CTRL){
+                    openFilter(data_ptr);
+                }
+                break;
+            case SDL_SCANCODE_ESCAPE:
+                if(!data_ptr->filter.empty()){
+                    setFilter(data_ptr, "");
+                } else {
+                    data_ptr->selected.clear();
+                }
+                break;
+            case SDL_SCANCODE_RETURN: //opens everything ctrl+clicked
+                if(!data_ptr->selected.empty()){
+                    openFiles(data_ptr, std::vector<std::string>(data_ptr->selected.begin(), data_ptr->selected.end()));
+                    data_ptr->selected.clear();
+                }
+                break;
+            case SDL_SCANCODE_D: //folder sizes on/off, shift+D counts again
+                if(event->key.keysym.mod & KMOD_SHIFT){
+                    data_ptr->sizer->forget();
+                    data_ptr->du_mode = true;
+                } else {
+                    data_ptr->du_mode = !data_ptr->du_mode;
+                }
+                break;
+            case SDL_SCANCODE_I: //image previews on/off
+                data_ptr->thumbnails = !data_ptr->thumbnails;
+                break;
+            case SDL_SCANCODE_F3: //frame cost overlay on/off
+                data_ptr->show_trace = !data_ptr->show_trace;
+                break;
+            case SDL_SCANCODE_F12: //texture and font counters on/off
+                data_ptr->show_resources = !data_ptr->show_resources;
+                break;
+            default:
+                break;
         }
     }
-    data_ptr->text_column_offset = 0;
 
-    // set color of background when erasing frame
-    //SDL_SetRenderDrawColor(renderer, 235, 235, 235, 255);
+    if(event->type == SDL_MOUSEWHEEL){ //wheel and touchpad, fractional on high resolution devices
+        int list_height = rowCount(data_ptr->nodes) * ROW_HEIGHT;
+        float notches = event->wheel.preciseY;
+        if(event->wheel.direction == SDL_MOUSEWHEEL_FLIPPED){
+            notches = -notches;
+        }
+        scrollBy(&data_ptr->scroll, -notches * WHEEL_STEP, list_height, HEIGHT);
+    }
 }
 
-void startRecursion(SDL_Renderer *renderer, AppData *data_ptr, int root_index, int start_from){
-    //reevaluate vector based on current root!
-    std::vector<int> assoc_parent_indices;
-    int start_size = data_ptr->file_entries.size();
-    //assoc_parent_indices.push_back(-1);
-
-    int count_add = 0;
-    for(int i = 0; i < data_ptr->file_entries[root_index].size(); i++){ //ASSEMBLY LOOP
-        if(data_ptr->file_entries[root_index][i].type == "directory" && data_ptr->file_entries[root_index][i].filename != ".."){
-            std::vector<FileData> child;
-            std::string filepath = data_ptr->current_dir + "/" + data_ptr->file_entries[root_index][i].filename;
-            updateFileList(&child, filepath, true);
-            data_ptr->file_entries.push_back(child);
-            assoc_parent_indices.push_back(i);
-            data_ptr->file_entries[root_index][i].child_index = data_ptr->file_entries.size() - 1; //for positioning on init. 
-            count_add++;
-        }
-    }
-
-    SDL_Color color = {0, 0, 0};
-    for(int i = start_from; i < data_ptr->file_entries.size(); i++){
-        for(int j = 0; j < data_ptr->file_entries[i].size(); j++){
-            //name, create texture and init the x y w h
-            int indent = 24 + data_ptr->file_entries[root_index][assoc_parent_indices[i - start_from]].icon_rect.x;
-            int y_parent = data_ptr->file_entries[root_index][assoc_parent_indices[i - start_from]].icon_rect.y;
-            const char* filename = data_ptr->file_entries[i][j].filename.c_str();
-            SDL_Surface *text_surf = TTF_RenderText_Solid(data_ptr->font, filename, color);
-            data_ptr->file_entries[i][j].text_texture = SDL_CreateTextureFromSurface(renderer, text_surf);
-            SDL_FreeSurface(text_surf);
-            data_ptr->file_entries[i][j].text_rect.x = 50 + indent;
-            data_ptr->file_entries[i][j].text_rect.y = y_parent + ((j+1) * 24);
-            SDL_Rect hold = data_ptr->file_entries[i][j].text_rect;
-            SDL_QueryTexture(data_ptr->file_entries[i][j].text_texture, NULL, NULL, &(data_ptr->file_entries[i][j].text_rect.w), &(data_ptr->file_entries[i][j].text_rect.h));
-
-            if(data_ptr->file_entries[i][j].text_rect.w> data_ptr->text_column_offset){
-                data_ptr->text_column_offset = data_ptr->file_entries[i][j].text_rect.w;
-            }
+//formats the display text of rows [first_row, last_row) into data_ptr->visible.
+//only ever called for the rows on screen, so no per-entry strings exist and
+//the cost follows the viewport and not the size of the folder.
+void initialize(AppData *data_ptr, int first_row, int last_row)
+{
+    TRACE_SCOPE("initialize");
+    data_ptr->visible.resize(last_row - first_row);
+    for(int r = first_row; r < last_row; r++) {
+        RowText *text = &data_ptr->visible[r - first_row];
+        text->row = findRow(data_ptr->nodes, r);
+        const RowRef &row = text->row;
+        const EntryStore &list = data_ptr->nodes[row.node].entries;
+
+        //name, straight out of the store's name arena
+        text->name = list.name(row.index);
+        text->name_len = list.nameLength(row.index);
+        text->name_w = data_ptr->atlas->measure(text->name, text->name_len);
+        text->name_hash = 2166136261u;
+        for(size_t i = 0; i < text->name_len; i++){
+            text->name_hash = (text->name_hash ^ (unsigned char)text->name[i]) * 16777619u;
+        }
 
-            //icon, create texture and init the x y w h
-            SDL_Surface *icon_surf;
-            if (data_ptr->file_entries[i][j].type == "directory") {
-                icon_surf = IMG_Load("resrc/images/dir.png");
-            }else if(data_ptr->file_entries[i][j].type == "executable") {
-                icon_surf = IMG_Load("resrc/images/exe.png");
-            }else if(data_ptr->file_entries[i][j].type == "image") {
-                icon_surf = IMG_Load("resrc/images/img.png");
-            }else if(data_ptr->file_entries[i][j].type == "video") {
-                icon_surf = IMG_Load("resrc/images/vid.png");
-            }else if(data_ptr->file_entries[i][j].type == "code") {
-                icon_surf = IMG_Load("resrc/images/code.png");
-            }else if(data_ptr->file_entries[i][j].type == "other") {
-                icon_surf = IMG_Load("resrc/images/oth.png");
+        //files without an extension are looked into once they are on screen
+        if(list.type(row.index) == TYPE_UNKNOWN){
+            FileType sniffed = TYPE_OTHER;
+            if(S_ISREG(list.mode(row.index))){
+                const std::string &dir = data_ptr->nodes[row.node].path;
+                sniffed = sniffFileType(((dir == "/" ? "" : dir) + "/" + text->name).c_str());
             }
+            data_ptr->nodes[row.node].entries.setSniffedType(row.index, sniffed);
+        }
 
-            data_ptr->file_entries[i][j].icon_texture = SDL_CreateTextureFromSurface(renderer, icon_surf);
-            SDL_FreeSurface(icon_surf);
-            data_ptr->file_entries[i][j].icon_rect.x = 24 + indent;
-            data_ptr->file_entries[i][j].icon_rect.y = y_parent + ((j+1) * 24);
-            data_ptr->file_entries[i][j].icon_rect.w = 24;
-            data_ptr->file_entries[i][j].icon_rect.h = 24;
+        //icon, just which slot of the icon atlas to draw
+        text->is_dir = (list.type(row.index) == TYPE_DIRECTORY);
+        text->icon = iconForType(list.type(row.index));
+        text->thumbnail = data_ptr->thumbnails && text->icon == ICON_IMG;
+        text->selected = false;
+        if(!data_ptr->selected.empty() && !text->is_dir){
+            const std::string &dir = data_ptr->nodes[row.node].path;
+            text->selected = data_ptr->selected.count((dir == "/" ? "" : dir) + "/" + text->name) > 0;
         }
-                
-        int max_y_ext = data_ptr->file_entries[i].size() * 24; //# of FileData entries in this expand * entry height //
-        for(int k = assoc_parent_indices[i - start_from]; k < data_ptr->file_entries[root_index].size(); k++){ //starting at the parent FileData instance, increment all Y vals by max_y_ext.
-            data_ptr->file_entries[root_index][k+1].icon_rect.y += max_y_ext;
-            data_ptr->file_entries[root_index][k+1].text_rect.y += max_y_ext;
+        text->disclosure = NULL;
+        if(text->is_dir && !list.isLink(row.index) && strcmp(text->name, "..") != 0){
+            int child = list.child(row.index);
+            bool open = child >= 0 && child < data_ptr->nodes.size() && data_ptr->nodes[child].expanded;
+            text->disclosure = open ? "-" : "+";
+        }
+
+        //permissions and sizes, if it is a file. folders have a size in du
+        //mode, growing while it is counted. asking again is free.
+        text->size[0] = '\0';
+        text->perms[0] = '\0';
+        if(text->is_dir && data_ptr->du_mode && strcmp(text->name, "..") != 0 && !list.isLink(row.index)){
+            const std::string &dir = data_ptr->nodes[row.node].path;
+            std::string path = (dir == "/" ? "" : dir) + "/" + text->name;
+            FolderSize total;
+            if(data_ptr->sizer->size(path, &total)){
+                double size;
+                SizeUnit units;
+                fitFilesizeToUnit(total.bytes, &size, &units);
+                snprintf(text->size, sizeof(text->size), total.done ? "%g %s" : "%g %s...", size, unitName(units));
+            } else {
+                data_ptr->sizer->measure(path);
+            }
+        } else if(!text->is_dir){
+            double size;
+            SizeUnit units;
+            fitFilesizeToUnit(list.fileSize(row.index), &size, &units);
+            snprintf(text->size, sizeof(text->size), "%g %s", size, unitName(units));
+            setFilePermField(text->perms, list.mode(row.index));
         }
     }
+}
 
-    assoc_parent_indices.clear();
+//hands paths to the opener, the explorer goes on without waiting for it
+void openFiles(AppData *data_ptr, const std::vector<std::string> &paths)
+{
+    std::string error;
+    if(!data_ptr->launcher->open(paths, &error)){
+        fprintf(stderr, "could not open: %s\n", error.c_str());
+    }
 }
-    
 
-void static_init(SDL_Renderer *renderer, AppData *data_ptr){
-    SDL_Surface *help_surf;
-    help_surf = IMG_Load("resrc/images/tips.png");
-    data_ptr->help_text = SDL_CreateTextureFromSurface(renderer, help_surf);
-    SDL_FreeSurface(help_surf);
-    data_ptr->help_rect.x = WIDTH - 90;
-    data_ptr->help_rect.y = HEIGHT - 175;
-    data_ptr->help_rect.w = 80;
-    data_ptr->help_rect.h = 160;
+//collects openers that have ended, so none are left as zombies. one that
+//failed usually means there is no application for the file
+void collectLaunches(AppData *data_ptr)
+{
+    std::vector<LaunchResult> ended;
+    data_ptr->launcher->reap(&ended);
+    for(int i = 0; i < ended.size(); i++){
+        if(ended[i].status != 0){
+            fprintf(stderr, "%s %s: exited with %d\n", LAUNCH_OPENER, ended[i].path.c_str(), ended[i].status);
+        }
+    }
+}
 
-    SDL_Surface *recur_surf;
-    if(data_ptr->recursion_switch){
-        recur_surf = IMG_Load("resrc/images/recur_on.png");
-    } else {
-        recur_surf = IMG_Load("resrc/images/recur_off.png");
+//throws away the current listing and starts reading current_dir in the background
+void openDirectory(AppData *data_ptr)
+{
+    TRACE_SCOPE("openDirectory");
+    data_ptr->recursion_switch = false;
+    data_ptr->filter.clear(); //a filter narrows one folder, not the next one
+    data_ptr->selected.clear();
+    if(data_ptr->typing_filter){
+        data_ptr->typing_filter = false;
+        SDL_StopTextInput();
     }
-    data_ptr->recur_texture = SDL_CreateTextureFromSurface(renderer, recur_surf);
-    SDL_FreeSurface(recur_surf);
-    data_ptr->recur_rect.x = WIDTH - 100;
-    data_ptr->recur_rect.y = 10;
-    data_ptr->recur_rect.h = 100;
-    data_ptr->recur_rect.w = 100;
-    
-    SDL_Surface *ust_surf;
-    ust_surf = IMG_Load("resrc/images/UST.png");
-    data_ptr->ust_texture = SDL_CreateTextureFromSurface(renderer, ust_surf);
-    SDL_FreeSurface(ust_surf);
-    data_ptr->ust_rect.x = WIDTH - 115;
-    data_ptr->ust_rect.y = HEIGHT - 98;
-    data_ptr->ust_rect.w = 115;
-    data_ptr->ust_rect.h = 98;
+    data_ptr->tree_walker->cancel();
+    data_ptr->walking = false;
+    data_ptr->nodes.clear();
+    TreeNode root;
+    root.path = data_ptr->current_dir;
+    root.loaded = true;
+    //a folder listed before shows up straight from the cache, the scan
+    //below then only checks it
+    data_ptr->revalidating = false;
+    data_ptr->scan_stamped = data_ptr->cache != NULL && stampDirectory(data_ptr->current_dir, &data_ptr->scan_stamp);
+    if(data_ptr->scan_stamped && data_ptr->cache->load(data_ptr->scan_stamp, &root.entries)){
+        data_ptr->revalidating = true;
+    }
+    root.entries.sort(data_ptr->sort_order); //when empty, only sets the order listings come in
+    data_ptr->nodes.push_back(root);
+    relayout(data_ptr, 0);
+    scrollReset(&data_ptr->scroll);
+    //watching before the scan starts means nothing slips between the two
+    data_ptr->watch_generation = data_ptr->watcher->clear();
+    data_ptr->watcher->watch(0, data_ptr->current_dir);
+    data_ptr->scan_generation = data_ptr->scan_worker->start(data_ptr->current_dir, data_ptr->sort_order);
+    data_ptr->scanning = true;
 }
 
-void render(SDL_Renderer *renderer, AppData *data_ptr)
+//swaps the newest listing the scan worker sent in for the root list. the
+//worker did the merging, only the last of several waiting listings is
+//used. while a cached listing is up only the complete one replaces it,
+//whatever differs then shows up as one diff.
+void collectScanResults(AppData *data_ptr)
 {
-    // erase renderer content
-    SDL_SetRenderDrawColor(renderer, 185, 185, 185, 185);
-    SDL_RenderClear(renderer);
-    
-    // TODO: draw!
-    for (int i=0; i<data_ptr->file_entries.size(); i++) {
-        for (int j=0; j<data_ptr->file_entries[i].size(); j++) {
-            SDL_RenderCopy(renderer, data_ptr->file_entries[i][j].icon_texture, NULL, &(data_ptr->file_entries[i][j].icon_rect));
-            SDL_RenderCopy(renderer, data_ptr->file_entries[i][j].text_texture, NULL, &(data_ptr->file_entries[i][j].text_rect));
-            if(data_ptr->file_entries[i][j].type != "directory" && !data_ptr->recursion_switch){
-                SDL_RenderCopy(renderer, data_ptr->file_entries[i][j].size_texture, NULL, &(data_ptr->file_entries[i][j].size_rect));
-                SDL_RenderCopy(renderer, data_ptr->file_entries[i][j].permissions_texture, NULL, &(data_ptr->file_entries[i][j].permissions_rect));
+    TRACE_SCOPE("collectScanResults");
+    ScanBatch *batch, *newest = NULL;
+    while(data_ptr->scan_worker->poll(&batch)){
+        if(batch->generation != data_ptr->scan_generation || (data_ptr->revalidating && !batch->done)){
+            delete batch;
+            continue;
+        }
+        delete newest;
+        newest = batch;
+    }
+    if(newest == NULL){
+        return;
+    }
+
+    if(newest->entries.sortOrder() != data_ptr->sort_order){
+        newest->entries.sort(data_ptr->sort_order); //re-sorted before the worker heard of it
+    }
+    std::vector<int> dropped;
+    data_ptr->nodes[0].entries.update(std::vector<std::string>(), true, newest->entries, &dropped);
+    for(int i = 0; i < dropped.size(); i++){
+        dropNode(data_ptr, dropped[i]);
+    }
+    linkChildren(&data_ptr->nodes, 0); //folders opened while it loads moved
+    relayout(data_ptr, 0);
+    if(newest->done){
+        data_ptr->scanning = false;
+        data_ptr->revalidating = false;
+        if(data_ptr->scan_stamped){
+            data_ptr->cache->store(data_ptr->scan_stamp, data_ptr->nodes[0].entries);
+        }
+    }
+    delete newest;
+}
+
+//puts the folders the tree walker finished in their place. they arrive in
+//any order, a folder whose node is not in yet just shows no children until
+//it is. each one only adds its own rows to the layout.
+void collectTreeResults(AppData *data_ptr)
+{
+    TRACE_SCOPE("collectTreeResults");
+    std::vector<TreeWalker::Result> results;
+    if(data_ptr->tree_walker->poll(&results)){
+        for(int i = 0; i < results.size(); i++){
+            TreeNode *node = results[i].node;
+            int index = results[i].index;
+            if(results[i].generation == data_ptr->tree_generation){
+                if(node->entries.sortOrder() != data_ptr->sort_order){
+                    node->entries.sort(data_ptr->sort_order); //re-sorted while it was being read
+                }
+                if(index >= data_ptr->nodes.size()){
+                    data_ptr->nodes.resize(index + 1);
+                }
+                //the placeholder knows where the parent lists it now
+                int parent_entry = data_ptr->nodes[index].parent_entry;
+                data_ptr->nodes[index] = std::move(*node);
+                data_ptr->nodes[index].parent_entry = parent_entry;
+                int parent = data_ptr->nodes[index].parent;
+                if(parent < 0 || data_ptr->nodes[parent].loaded){
+                    data_ptr->watcher->watch(index, data_ptr->nodes[index].path);
+                }
+                linkChildren(&data_ptr->nodes, index);
+                relayout(data_ptr, index);
             }
-            
+            delete node;
         }
     }
+    if(data_ptr->tree_walker->progress().done){
+        data_ptr->walking = false;
+    }
+}
 
-    SDL_RenderCopy(renderer, data_ptr->help_text, NULL, &(data_ptr->help_rect));
-    SDL_RenderCopy(renderer, data_ptr->recur_texture, NULL, &(data_ptr->recur_rect));
+//opens or closes one folder of the list. a folder read before is just shown
+//or hidden again, anything else is read on the tree walker and shows up when
+//it is in. either way only the rows of that folder move.
+void toggleFolder(AppData *data_ptr, const RowRef &row){
+    const EntryStore &list = data_ptr->nodes[row.node].entries;
+    if(list.type(row.index) != TYPE_DIRECTORY || list.isLink(row.index) || strcmp(list.name(row.index), "..") == 0){
+        return;
+    }
+    int child = list.child(row.index);
+    if(child >= 0){
+        if(child < data_ptr->nodes.size() && data_ptr->nodes[child].loaded){
+            setExpanded(&data_ptr->nodes, child, !data_ptr->nodes[child].expanded);
+            int list_height = rowCount(data_ptr->nodes) * ROW_HEIGHT;
+            scrollTo(&data_ptr->scroll, data_ptr->scroll.target, list_height, HEIGHT); //may have gotten shorter
+        }
+        return; //still being read otherwise
+    }
 
-    // show rendered frame
-    SDL_RenderPresent(renderer);
+    const std::string &dir = data_ptr->nodes[row.node].path;
+    std::string path = (dir == "/" ? "" : dir) + "/" + list.name(row.index);
+    data_ptr->tree_generation = data_ptr->tree_walker->open(path, row.node, row.depth + 1, data_ptr->sort_order, &child);
+    data_ptr->walking = true;
+    data_ptr->nodes[row.node].entries.setChild(row.index, child);
+    linkChildren(&data_ptr->nodes, row.node);
+    data_ptr->watcher->watch(child, path); //changes while it is read are held until it is in
 }
 
+//applies what the watcher saw to the folders it was seen in. each folder
+//gets one sorted diff however many events piled up, only its own rows move.
+//changes to a folder still being read wait for it, re-applying one the read
+//already saw changes nothing.
+void collectWatchChanges(AppData *data_ptr)
+{
+    TRACE_SCOPE("collectWatchChanges");
+    std::vector<FolderChanges> changes;
+    data_ptr->watcher->poll(&changes);
+    changes.insert(changes.begin(), data_ptr->held_changes.begin(), data_ptr->held_changes.end());
+    data_ptr->held_changes.clear();
+    if(changes.empty()){
+        return;
+    }
 
-void updateFileList(std::vector<FileData> *files, std::string filepath, bool recur){ //called at start and whenever a new folder is expanded/opened
-    
-    DIR *dir;
-    struct stat current_file_info;
-    struct dirent *entry;
-    
-    //flush vector of prev info if it exists
-    files->clear();
-    
-    if((dir = opendir (filepath.c_str())) != NULL){
-        while((entry = readdir(dir)) != NULL){
-            if(entry->d_type == DT_REG){ //regular file
-                FileData file;
-                file.filename = entry->d_name;
-                file.type = entry->d_type;
-                struct stat filestats;
-
-                std::string fpath = (filepath + "/" + entry->d_name);
-                stat(fpath.c_str(), &filestats); //get more detailed information on the file.
-
-                file.size = filestats.st_size;
-                fitFilesizeToUnit(&file);
-                setFilePermField(&file, &filestats);
-                convertToUsableType(&file);
-                files->push_back(file);
-
-            } else if(entry->d_type == DT_DIR){
-                FileData folder;
-                folder.filename = entry->d_name;
-                folder.type = "directory";
-                if(folder.filename != "."){
-                    files->push_back(folder); //add folder w/name & type into list
-                }
-            } else {
-               std::cout << "dirent found unknown filetype.\n";
+    for(int i = 0; i < changes.size(); i++){
+        FolderChanges &folder = changes[i];
+        int node = folder.node;
+        if(folder.generation != data_ptr->watch_generation){
+            continue; //from a listing that is gone
+        }
+        bool loaded = node < data_ptr->nodes.size() && data_ptr->nodes[node].loaded;
+        if(node == 0 ? data_ptr->scanning : !loaded){
+            if(data_ptr->scanning || data_ptr->walking){
+                data_ptr->held_changes.push_back(folder);
             }
+            continue; //otherwise it was dropped and will not come back
         }
+
+        EntryStore fresh;
+        for(int j = 0; j < folder.entries.size(); j++){
+            if(node != 0 && folder.entries[j].name == ".."){
+                continue; //a relisted subfolder, like updateFileList(recur)
+            }
+            addScanEntry(&fresh, folder.entries[j]);
+        }
+        fresh.sort(data_ptr->sort_order);
+
+        //what is counted of the folder and those above it is stale now
+        const std::string &dir = data_ptr->nodes[node].path;
+        data_ptr->sizer->forget(dir);
+        for(int j = 0; j < folder.names.size(); j++){
+            data_ptr->sizer->forget((dir == "/" ? "" : dir) + "/" + folder.names[j]);
+        }
+
+        std::vector<int> dropped;
+        data_ptr->nodes[node].entries.update(folder.names, folder.relist, fresh, &dropped);
+        for(int j = 0; j < dropped.size(); j++){
+            dropNode(data_ptr, dropped[j]);
+        }
+        linkChildren(&data_ptr->nodes, node);
+        relayout(data_ptr, node);
     }
 
-    std::sort(files->begin(), files->end(), compareFunction);
+    int list_height = rowCount(data_ptr->nodes) * ROW_HEIGHT;
+    scrollTo(&data_ptr->scroll, data_ptr->scroll.target, list_height, HEIGHT); //may have gotten shorter
 }
 
-void fitFilesizeToUnit(FileData *file){
-    if (file->size >= 1024 && file->size  < 1048576) {
-        file->size = file->size / 1024;
-        file->units  = "KB";
-    }else if (file->size >= 1048576 && file->size < 1073741824) {
-        file->size  = file->size  / 1048576;
-        file->units  = "MB";
-    }else if (file->size  >= 1073741824) {
-        file->size  = file->size  / 1073741824;
-        file->units  = "GB";
-    }else {
-        file->units  = "B";
-    }
-    file->size = trunc(file->size);
+//forgets an opened folder that went away, and everything opened under it
+void dropNode(AppData *data_ptr, int node)
+{
+    if(node >= data_ptr->nodes.size()){
+        return; //never came in
+    }
+    data_ptr->watcher->unwatch(node);
+    TreeNode &gone = data_ptr->nodes[node];
+    for(size_t i = 0; i < gone.entries.size(); i++){
+        if(gone.entries.child(i) > node){
+            dropNode(data_ptr, gone.entries.child(i));
+        }
+    }
+    data_ptr->nodes[node] = TreeNode();
 }
 
-void setFilePermField(FileData *file, struct stat *filestats){
-    file->perms = "[";
-    //Permissions
-    if( filestats->st_mode & S_IRUSR ){
-        file->perms += "r";
+//picking the key that is already active flips the direction instead
+SortOrder sortBy(SortOrder order, SortKey key){
+    if(order.key == key){
+        order.descending = !order.descending;
+    } else {
+        order.key = key;
+        order.descending = false;
     }
-    if( filestats->st_mode & S_IWUSR ){
-        file->perms += "w";
+    return order;
+}
+
+//re-sorts everything already loaded, no rescan. batches still arriving are
+//merged in the new order.
+void sortListing(AppData *data_ptr, const SortOrder &order){
+    data_ptr->sort_order = order;
+    if(data_ptr->scanning){
+        data_ptr->scan_worker->setOrder(order);
     }
-    if( filestats->st_mode & S_IXUSR ){
-        file->perms += "x";
-        file->type = "executable";
+    for(int i = 0; i < data_ptr->nodes.size(); i++){
+        data_ptr->nodes[i].entries.sort(data_ptr->sort_order);
     }
-    file->perms += "] | [";
-    if( filestats->st_mode & S_IRGRP ){
-        file->perms += "r";
+    for(int i = 0; i < data_ptr->nodes.size(); i++){
+        linkChildren(&data_ptr->nodes, i);
+        if(!data_ptr->filter.empty() && data_ptr->nodes[i].loaded){
+            filterNode(&data_ptr->nodes, i, data_ptr->filter); //entries moved under it
+        }
     }
-    if( filestats->st_mode & S_IWGRP ){
-        file->perms += "w";
+    layoutTree(&data_ptr->nodes);
+}
+
+//lays out a node whose entries changed, filtering them first if a filter is on
+void relayout(AppData *data_ptr, int node)
+{
+    if(!data_ptr->filter.empty()){
+        filterNode(&data_ptr->nodes, node, data_ptr->filter);
     }
-    if( filestats->st_mode & S_IXGRP ){
-        file->perms += "x";
-        file->type = "executable";
+    layoutNode(&data_ptr->nodes, node);
+}
+
+//gives the keyboard to the filter bar. indexes are built now, not on the
+//first keystroke.
+void openFilter(AppData *data_ptr)
+{
+    data_ptr->typing_filter = true;
+    for(int i = 0; i < data_ptr->nodes.size(); i++){
+        if(data_ptr->nodes[i].loaded){
+            prepareFilter(&data_ptr->nodes, i);
+        }
     }
-    file->perms += "] | [";
-    if( filestats->st_mode & S_IROTH ){
-        file->perms += "r";
+    SDL_StartTextInput();
+}
+
+//narrows every loaded folder to text. a keystroke that only adds to the
+//text only looks at what matched before.
+void setFilter(AppData *data_ptr, const std::string &text)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    data_ptr->filter = text;
+    data_ptr->filter_matches = 0;
+    for(int i = 0; i < data_ptr->nodes.size(); i++){
+        TreeNode &node = data_ptr->nodes[i];
+        if(node.loaded){
+            filterNode(&data_ptr->nodes, i, text);
+            data_ptr->filter_matches += std::count(node.shown.begin(), node.shown.end(), 1);
+        }
     }
-    if( filestats->st_mode & S_IWOTH ){
-        file->perms += "w";
+    layoutTree(&data_ptr->nodes);
+    scrollReset(&data_ptr->scroll);
+    std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - start;
+    data_ptr->filter_ms = took.count();
+}
+
+//keys while the filter bar is open. false for the ones that should still
+//scroll the list, letters arrive as SDL_TEXTINPUT instead.
+bool editFilter(AppData *data_ptr, const SDL_Keysym &key)
+{
+    switch(key.scancode){
+        case SDL_SCANCODE_UP:
+        case SDL_SCANCODE_DOWN:
+        case SDL_SCANCODE_PAGEUP:
+        case SDL_SCANCODE_PAGEDOWN:
+        case SDL_SCANCODE_HOME:
+        case SDL_SCANCODE_END:
+            return false;
+        case SDL_SCANCODE_BACKSPACE: {
+            std::string text = data_ptr->filter;
+            while(!text.empty() && (text.back() & 0xC0) == 0x80){
+                text.pop_back(); //continuation bytes of a UTF-8 character
+            }
+            if(!text.empty()){
+                text.pop_back();
+            }
+            setFilter(data_ptr, text);
+            return true;
+        }
+        case SDL_SCANCODE_ESCAPE: //closes the bar and drops the filter
+            setFilter(data_ptr, "");
+            data_ptr->typing_filter = false;
+            SDL_StopTextInput();
+            return true;
+        case SDL_SCANCODE_RETURN: //closes the bar, the filter stays
+            data_ptr->typing_filter = false;
+            SDL_StopTextInput();
+            return true;
+        default:
+            return true;
     }
-    if( filestats->st_mode & S_IXOTH ){
-        file->perms += "x";
-        file->type = "executable";
+}
+
+void static_init(SDL_Renderer *renderer, AppData *data_ptr){
+    //all of these come out of the icon cache, so calling this again costs nothing
+    data_ptr->help_icon = ICON_TIPS;
+    data_ptr->help_rect.x = WIDTH - 90;
+    data_ptr->help_rect.y = HEIGHT - 175;
+    data_ptr->help_rect.w = 80;
+    data_ptr->help_rect.h = 160;
+
+    if(data_ptr->recursion_switch){
+        data_ptr->recur_icon = ICON_RECUR_ON;
+    } else {
+        data_ptr->recur_icon = ICON_RECUR_OFF;
     }
-    file->perms += "]";
+    data_ptr->recur_rect.x = WIDTH - 100;
+    data_ptr->recur_rect.y = 10;
+    data_ptr->recur_rect.h = 100;
+    data_ptr->recur_rect.w = 100;
+    
+    data_ptr->ust_icon = ICON_UST;
+    data_ptr->ust_rect.x = WIDTH - 115;
+    data_ptr->ust_rect.y = HEIGHT - 98;
+    data_ptr->ust_rect.w = 115;
+    data_ptr->ust_rect.h = 98;
 
+    //they only change with the recursion switch, so they are drawn into the
+    //chrome texture once and every frame copies that
+    data_ptr->frame->composeChrome(data_ptr->recur_icon, [renderer, data_ptr](){
+        data_ptr->icons->draw(renderer, data_ptr->help_icon, &data_ptr->help_rect);
+        data_ptr->icons->draw(renderer, data_ptr->recur_icon, &data_ptr->recur_rect);
+    });
 }
 
-void convertToUsableType(FileData *file){
-    std::string filename = file->filename;
-    
-    //search properties
-    std::vector<std::string> img = {".jpg", ".jpeg", ".png", ".tif", ".tiff", ".gif"};
+//whether two versions of a row would look the same on screen
+static bool sameRow(const RowText &a, const RowText &b)
+{
+    return a.row.node == b.row.node && a.row.index == b.row.index && a.row.depth == b.row.depth &&
+           a.name == b.name && a.name_len == b.name_len && a.name_hash == b.name_hash &&
+           a.disclosure == b.disclosure && a.icon == b.icon && a.selected == b.selected &&
+           a.thumbnail == b.thumbnail && strcmp(a.size, b.size) == 0 && strcmp(a.perms, b.perms) == 0;
+}
+
+static bool sameOverlay(const Overlay &a, const Overlay &b)
+{
+    return a.rect.x == b.rect.x && a.rect.y == b.rect.y && a.rect.w == b.rect.w && a.rect.h == b.rect.h &&
+           a.lines == b.lines;
+}
 
-    std::vector<std::string> vid = {".mp4", ".mov", ".mkv", ".avi", ".webm"};
+//the bars and boxes over the list, top to bottom of the drawing order
+static void buildOverlays(AppData *data_ptr, std::vector<Overlay> *overlays)
+{
+    overlays->clear();
+    //filter bar, above the progress bar if both are up
+    int bar_y = HEIGHT - 28;
+    if(data_ptr->typing_filter || !data_ptr->filter.empty()){
+        char status[96];
+        snprintf(status, sizeof(status), "  %zu matches (%.1f ms)", data_ptr->filter_matches, data_ptr->filter_ms);
+        Overlay bar = { { 0, data_ptr->walking ? bar_y - 28 : bar_y, WIDTH, 28 }, { 250, 250, 210, 255 } };
+        bar.lines.push_back("filter: " + data_ptr->filter + (data_ptr->typing_filter ? "_" : "") + status);
+        overlays->push_back(bar);
+    }
 
-    std::vector<std::string> code = {".h", ".c", ".cpp", ".py", ".java", ".js"};
+    //how far the recursive view has got
+    if(data_ptr->walking){
+        TreeProgress progress = data_ptr->tree_walker->progress();
+        char status[96];
+        snprintf(status, sizeof(status), "reading: %zu folders, %zu entries, %zu folders left",
+                 progress.folders, progress.entries, progress.folders_left);
+        Overlay bar = { { 0, HEIGHT - 28, WIDTH, 28 }, { 220, 220, 220, 255 } };
+        bar.lines.push_back(status);
+        overlays->push_back(bar);
+    }
 
-    
+    if(data_ptr->show_resources){
+        ResourceCounts counts = data_ptr->resources->counts();
+        char status[128];
+        snprintf(status, sizeof(status), "textures %d, %.1f of %.0f MB (peak %.1f), fonts %d, evictions %u",
+                 counts.textures, counts.texture_bytes / 1048576.0, counts.budget / 1048576.0,
+                 counts.peak_bytes / 1048576.0, counts.fonts, counts.refused);
+        Overlay bar = { { 0, 0, WIDTH, 28 }, { 220, 220, 220, 255 } };
+        bar.lines.push_back(status);
+        overlays->push_back(bar);
+    }
 
-    for (int i = 0; i < img.size(); i++) {
-        std::size_t found = filename.find(img[i]);
-        if (found != std::string::npos) {
-            file->type = "image";
-            return;
+    //last frame's counters, then every scope that ended in it: total (longest)
+    if(data_ptr->show_trace){
+        const TraceFrame &frame = data_ptr->trace_frame;
+        FrameStats frames = data_ptr->frame->stats();
+        Overlay box = { { 0, data_ptr->show_resources ? 28 : 0, WIDTH / 2, 0 }, { 255, 255, 230, 255 } };
+        char line[128];
+        snprintf(line, sizeof(line), "frames drawn %u, skipped %u, last %d%% of the window",
+                 frames.drawn, frames.skipped, (int)(100.0 * frames.last_area / (WIDTH * HEIGHT)));
+        box.lines.push_back(line);
+        if(traceBuilt()){
+            snprintf(line, sizeof(line), "syscalls %llu, textures %llu, draw calls %llu",
+                     (unsigned long long)frame.counters[TRACE_SYSCALLS], (unsigned long long)frame.counters[TRACE_TEXTURES],
+                     (unsigned long long)frame.counters[TRACE_DRAW_CALLS]);
+            box.lines.push_back(line);
+            for(int i = 0; i < frame.scopes; i++){
+                snprintf(line, sizeof(line), "%s %.2f ms (%.2f)", frame.scope_names[i], frame.scope_ms[i], frame.worst_ms[i]);
+                box.lines.push_back(line);
+            }
+        } else {
+            box.lines.push_back("no instrumentation in this build, make TRACE=1");
         }
+        box.rect.h = (int)box.lines.size() * 24 + 4;
+        overlays->push_back(box);
     }
+}
+
+//draws what changed since the last frame. the rows on screen are formatted
+//again and compared with the ones drawn, a row that differs and a bar that
+//changed or went away are damage; scrolling or a wider name column damages
+//everything. a frame with no damage is skipped, nothing is presented.
+void render(SDL_Renderer *renderer, AppData *data_ptr)
+{
+    TRACE_SCOPE("render");
+    if(!data_ptr->view_stale && !data_ptr->frame->damaged()){
+        data_ptr->frame->end(renderer); //an expose still needs the frame shown again
+        return;
+    }
+    data_ptr->view_stale = false;
 
-    for (int i = 0; i < vid.size(); i++) {
-        std::size_t found = filename.find(vid[i]);
-        if (found != std::string::npos) {
-            file->type = "video";
-            return;
+    //only the rows that intersect the window (plus a little overscan) are touched
+    int first_row, last_row;
+    int offset = data_ptr->scroll.offset();
+    visibleRows(rowCount(data_ptr->nodes), offset, HEIGHT, &first_row, &last_row);
+    initialize(data_ptr, first_row, last_row);
+
+    //size and permission columns start past the longest name on screen
+    data_ptr->text_column_offset = 0;
+    for (int r = first_row; r < last_row; r++) {
+        const RowRef &row = data_ptr->visible[r - first_row].row;
+        int text_end = 50 + row.depth * ROW_INDENT + data_ptr->visible[r - first_row].name_w;
+        if(text_end > data_ptr->text_column_offset){
+            data_ptr->text_column_offset = text_end;
         }
     }
 
-    for (int i = 0; i < code.size(); i++) {
-        std::size_t found = filename.find(code[i]);
-        if (found!=std::string::npos) {
-            file->type = "code";
-            return;
+    //rows that look different, or are there in only one of the two frames
+    if(offset != data_ptr->drawn_offset || first_row != data_ptr->drawn_first_row ||
+       data_ptr->text_column_offset != data_ptr->drawn_column){
+        data_ptr->frame->damageAll();
+    } else {
+        int drawn_last = first_row + data_ptr->drawn.size();
+        for(int r = first_row; r < std::max(last_row, drawn_last); r++){
+            bool same = r < last_row && r < drawn_last &&
+                        sameRow(data_ptr->visible[r - first_row], data_ptr->drawn[r - first_row]) &&
+                        !(data_ptr->visible[r - first_row].thumbnail && data_ptr->thumbs_changed);
+            if(!same){
+                SDL_Rect row_rect = { 0, r * ROW_HEIGHT - offset, WIDTH, ROW_HEIGHT };
+                data_ptr->frame->damage(row_rect);
+            }
         }
     }
+    std::vector<Overlay> overlays;
+    buildOverlays(data_ptr, &overlays);
+    std::vector<Overlay> &drawn_overlays = data_ptr->drawn_overlays;
+    for(int i = 0; i < std::max(overlays.size(), drawn_overlays.size()); i++){
+        if(i < overlays.size() && i < drawn_overlays.size() && sameOverlay(overlays[i], drawn_overlays[i])){
+            continue;
+        }
+        if(i < overlays.size()){
+            data_ptr->frame->damage(overlays[i].rect);
+        }
+        if(i < drawn_overlays.size()){
+            data_ptr->frame->damage(drawn_overlays[i].rect); //what was under it shows again
+        }
+    }
+    data_ptr->drawn = data_ptr->visible;
+    data_ptr->drawn_first_row = first_row;
+    data_ptr->drawn_offset = offset;
+    data_ptr->drawn_column = data_ptr->text_column_offset;
+    drawn_overlays.swap(overlays);
 
-    if(file->type == "executable"){
+    SDL_Color background = { 185, 185, 185, 255 };
+    if(!data_ptr->frame->begin(renderer, background)){
+        data_ptr->frame->end(renderer);
         return;
     }
 
-    file->type = "other";
+    //selected rows get a background, all in one draw call
+    std::vector<SDL_Rect> marks;
+    for (int r = first_row; r < last_row; r++) {
+        SDL_Rect mark = { 0, r * ROW_HEIGHT - offset, WIDTH, ROW_HEIGHT };
+        if(data_ptr->visible[r - first_row].selected && data_ptr->frame->touches(mark)){
+            marks.push_back(mark);
+        }
+    }
+    if(!marks.empty()){
+        SDL_SetRenderDrawColor(renderer, 160, 190, 230, 255);
+        SDL_RenderFillRects(renderer, marks.data(), marks.size());
+        TRACE_COUNT(TRACE_DRAW_CALLS, 1);
+    }
+
+    for (int r = first_row; r < last_row; r++) {
+        const RowText &text = data_ptr->visible[r - first_row];
+        int indent = text.row.depth * ROW_INDENT;
+        int y = r * ROW_HEIGHT - offset;
+        SDL_Rect row_rect = { 0, y, WIDTH, ROW_HEIGHT };
+        if(!data_ptr->frame->touches(row_rect)){
+            continue;
+        }
+
+        if(text.disclosure != NULL){
+            data_ptr->atlas->draw(text.disclosure, 1, 8 + indent, y);
+        }
+        SDL_Rect icon_rect = { 24 + indent, y, 24, 24 };
+        bool drawn = false;
+        if(text.thumbnail){
+            const TreeNode &node = data_ptr->nodes[text.row.node];
+            std::string path = (node.path == "/" ? "" : node.path) + "/" + text.name;
+            drawn = data_ptr->thumbs->draw(renderer, path, node.entries.modifiedTime(text.row.index), &icon_rect);
+        }
+        if(!drawn){
+            data_ptr->icons->draw(renderer, text.icon, &icon_rect);
+        }
+        data_ptr->atlas->draw(text.name, text.name_len, 50 + indent, y);
+        data_ptr->atlas->draw(text.size, strlen(text.size), data_ptr->text_column_offset + 50, y);
+        data_ptr->atlas->draw(text.perms, strlen(text.perms), data_ptr->text_column_offset + 200, y);
+    }
+    data_ptr->atlas->flush(renderer); //all the text in one draw call
+
+    for(int i = 0; i < drawn_overlays.size(); i++){
+        const Overlay &overlay = drawn_overlays[i];
+        if(!data_ptr->frame->touches(overlay.rect)){
+            continue;
+        }
+        SDL_SetRenderDrawColor(renderer, overlay.color.r, overlay.color.g, overlay.color.b, overlay.color.a);
+        SDL_RenderFillRect(renderer, &overlay.rect);
+        TRACE_COUNT(TRACE_DRAW_CALLS, 1);
+        for(int l = 0; l < overlay.lines.size(); l++){
+            data_ptr->atlas->draw(overlay.lines[l].c_str(), overlay.lines[l].size(), 10, overlay.rect.y + 2 + l * 24);
+        }
+        data_ptr->atlas->flush(renderer);
+    }
+
+    //help and recursion icons come from the chrome texture, on top of everything
+    data_ptr->frame->end(renderer);
+}
+
+//false for events that cannot change what is shown (the mouse moving,
+//keys going up), so they do not cost a frame
+bool changesView(AppData *data_ptr, const SDL_Event *event)
+{
+    switch(event->type){
+        case SDL_MOUSEMOTION:
+        case SDL_MOUSEBUTTONUP:
+        case SDL_KEYUP:
+        case SDL_TEXTEDITING:
+            return false;
+        case SDL_WINDOWEVENT:
+            if(event->window.event == SDL_WINDOWEVENT_EXPOSED || event->window.event == SDL_WINDOWEVENT_RESTORED){
+                data_ptr->frame->exposed();
+            }
+            return false;
+        case SDL_RENDER_TARGETS_RESET:
+        case SDL_RENDER_DEVICE_RESET:
+            data_ptr->frame->lost();
+            return true;
+        default:
+            return true;
+    }
+}
+
+//--soak N: goes into the first subfolder and back out N times, each time
+//reading the folder, laying it out and drawing it, and prints what the
+//resource pool holds and the resident size of the process along the way.
+//both should stay flat however many folders have been shown.
+void soakTest(SDL_Renderer *renderer, AppData *data_ptr, int rounds)
+{
+    std::string home = data_ptr->current_dir;
+    std::string child = home;
+    data_ptr->thumbnails = true; //thumbnail pages churn as well
+    for(int round = 0; round <= rounds; round++){
+        while(data_ptr->scanning){
+            collectScanResults(data_ptr);
+            SDL_Delay(1);
+        }
+        static_init(renderer, data_ptr);
+        data_ptr->thumbs->upload(renderer);
+        data_ptr->view_stale = true;
+        render(renderer, data_ptr);
+        if(round == 0){
+            const EntryStore &list = data_ptr->nodes[0].entries;
+            for(size_t i = 0; i < list.size(); i++){
+                if(list.type(i) == TYPE_DIRECTORY && strcmp(list.name(i), "..") != 0){
+                    child = (home == "/" ? "" : home) + "/" + list.name(i);
+                    break;
+                }
+            }
+        }
+        if(round % 1000 == 0 || round == rounds){
+            ResourceCounts counts = data_ptr->resources->counts();
+            long pages = 0, resident = 0;
+            FILE *statm = fopen("/proc/self/statm", "r");
+            if(statm != NULL){
+                if(fscanf(statm, "%ld %ld", &pages, &resident) != 2){
+                    resident = 0;
+                }
+                fclose(statm);
+            }
+            printf("soak %d: textures %d, %zu bytes (peak %zu), fonts %d, resident %ld KB\n", round,
+                   counts.textures, counts.texture_bytes, counts.peak_bytes, counts.fonts,
+                   resident * sysconf(_SC_PAGESIZE) / 1024);
+        }
+        data_ptr->current_dir = (round % 2 == 0) ? child : home;
+        openDirectory(data_ptr);
+    }
 }
@@ -0,0 +1,362 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "metacache.h"
+#include "entrystore.h"
+
+static const char CACHE_MAGIC[8] = { 'O', 'S', 'F', 'X', 'L', 'S', 'T', '\n' };
+
+//all records are naturally aligned fixed-width structs so they can be read
+//straight out of the mapping. the cache never leaves the machine that wrote
+//it, byte order and layout are simply the native ones.
+struct MetaCache::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t folder_count;
+    uint64_t file_size;
+    uint64_t table_checksum; //over the folder table
+};
+
+struct MetaCache::FolderRecord {
+    uint64_t dev;
+    uint64_t ino;
+    int64_t mtime_ns;
+    uint64_t last_used;      //seconds, decides what is trimmed first
+    uint64_t entries_offset; //from the start of the file
+    uint64_t names_offset;
+    uint32_t entry_count;
+    uint32_t names_size;
+    uint64_t checksum;       //over the entry records and the names
+};
+
+struct MetaCache::EntryRecord {
+    uint64_t size;
+    int64_t mtime;
+    uint32_t name_offset; //from the folder's names_offset
+    uint32_t mode;
+    uint16_t name_length;
+    uint8_t type;
+    uint8_t is_link;
+    uint32_t reserved;
+};
+
+//a listing taken this run, already in file form
+struct MetaCache::Listing {
+    DirStamp stamp;
+    std::vector<EntryRecord> entries;
+    std::vector<char> names;
+};
+
+//FNV-1a, enough to notice a torn or scribbled file
+static uint64_t checksum(const void *bytes, size_t len, uint64_t hash = 14695981039346656037ull){
+    const unsigned char *p = (const unsigned char *)bytes;
+    for(size_t i = 0; i < len; i++){
+        hash = (hash ^ p[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+bool stampDirectory(const std::string &path, DirStamp *stamp){
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)){
+        return false;
+    }
+    stamp->dev = st.st_dev;
+    stamp->ino = st.st_ino;
+    stamp->mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+MetaCache::MetaCache(const std::string &cache_file)
+    : file(cache_file), data(NULL), data_size(0), folders(NULL), folder_count(0)
+{
+    if(!map()){
+        unmap();
+    }
+}
+
+MetaCache::~MetaCache(){
+    unmap();
+    for(std::map<Key, Listing *>::iterator it = stored.begin(); it != stored.end(); ++it){
+        delete it->second;
+    }
+}
+
+std::string MetaCache::cacheFile(){
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    std::string dir;
+    if(xdg != NULL && xdg[0] == '/'){
+        dir = xdg;
+    } else {
+        const char *home = getenv("HOME");
+        dir = std::string(home != NULL ? home : "") + "/.cache";
+    }
+    return dir + "/os-fileexplorer/listings";
+}
+
+//maps the file and checks everything but the per-folder checksums, which
+//are only worth computing for folders actually shown
+bool MetaCache::map(){
+    static_assert(sizeof(Header) == 32 && sizeof(FolderRecord) == 64 && sizeof(EntryRecord) == 32,
+                  "cache records changed size, bump CACHE_VERSION");
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Header) || st.st_size > CACHE_MAX_BYTES){
+        close(fd);
+        return false;
+    }
+    void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED){
+        return false;
+    }
+    data = (const unsigned char *)mapped;
+    data_size = st.st_size;
+
+    const Header *header = (const Header *)data;
+    if(memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header->version != CACHE_VERSION
+       || header->file_size != data_size){
+        return false; //another version, or cut short
+    }
+    size_t table_size = (size_t)header->folder_count * sizeof(FolderRecord);
+    if(table_size > data_size - sizeof(Header)){
+        return false;
+    }
+    folders = (const FolderRecord *)(data + sizeof(Header));
+    if(checksum(folders, table_size) != header->table_checksum){
+        return false;
+    }
+    folder_count = header->folder_count;
+    return true;
+}
+
+void MetaCache::unmap(){
+    if(data != NULL){
+        munmap((void *)data, data_size);
+    }
+    data = NULL;
+    data_size = 0;
+    folders = NULL;
+    folder_count = 0;
+}
+
+const MetaCache::FolderRecord *MetaCache::find(const Key &key) const {
+    const FolderRecord *last = folders + folder_count;
+    const FolderRecord *found = std::lower_bound(folders, last, key, [](const FolderRecord &folder, const Key &k){
+        return folder.dev < k.first || (folder.dev == k.first && folder.ino < k.second);
+    });
+    if(found == last || found->dev != key.first || found->ino != key.second){
+        return NULL;
+    }
+    return found;
+}
+
+//the folder's regions lie inside the file and still hash to what was written
+bool MetaCache::valid(const FolderRecord *folder) const {
+    uint64_t entries_size = (uint64_t)folder->entry_count * sizeof(EntryRecord);
+    if(folder->entry_count > CACHE_MAX_FOLDER_ENTRIES
+       || folder->entries_offset > data_size || entries_size > data_size - folder->entries_offset
+       || folder->entries_offset % sizeof(uint64_t) != 0
+       || folder->names_offset > data_size || folder->names_size > data_size - folder->names_offset){
+        return false;
+    }
+    uint64_t hash = checksum(data + folder->entries_offset, entries_size);
+    hash = checksum(data + folder->names_offset, folder->names_size, hash);
+    if(hash != folder->checksum){
+        return false;
+    }
+    const EntryRecord *entries = (const EntryRecord *)(data + folder->entries_offset);
+    for(uint32_t i = 0; i < folder->entry_count; i++){
+        if(entries[i].name_offset > folder->names_size
+           || entries[i].name_length > folder->names_size - entries[i].name_offset){
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MetaCache::load(const DirStamp &stamp, EntryStore *entries){
+    Key key(stamp.dev, stamp.ino);
+    const EntryRecord *records;
+    const char *names;
+    uint32_t count;
+    std::map<Key, Listing *>::iterator taken = stored.find(key);
+    if(taken != stored.end()){
+        if(taken->second->stamp.mtime_ns != stamp.mtime_ns){
+            return false;
+        }
+        records = taken->second->entries.data();
+        names = taken->second->names.data();
+        count = taken->second->entries.size();
+    } else {
+        const FolderRecord *folder = find(key);
+        if(folder == NULL || folder->mtime_ns != stamp.mtime_ns || !valid(folder)){
+            return false;
+        }
+        records = (const EntryRecord *)(data + folder->entries_offset);
+        names = (const char *)(data + folder->names_offset);
+        count = folder->entry_count;
+        used[key] = time(NULL);
+    }
+
+    entries->clear();
+    size_t name_bytes = 0;
+    for(uint32_t i = 0; i < count; i++){
+        name_bytes += records[i].name_length + 1;
+    }
+    entries->reserve(count, name_bytes);
+    for(uint32_t i = 0; i < count; i++){
+        const EntryRecord &r = records[i];
+        entries->add(names + r.name_offset, r.name_length, (FileType)r.type, r.mode, r.size, r.mtime, r.is_link != 0);
+    }
+    return true;
+}
+
+void MetaCache::store(const DirStamp &stamp, const EntryStore &entries){
+    Key key(stamp.dev, stamp.ino);
+    if(entries.size() > CACHE_MAX_FOLDER_ENTRIES){
+        return;
+    }
+    Listing *listing = new Listing();
+    listing->stamp = stamp;
+    listing->entries.resize(entries.size());
+    for(size_t i = 0; i < entries.size(); i++){
+        EntryRecord &r = listing->entries[i];
+        memset(&r, 0, sizeof(r));
+        r.size = entries.fileSize(i);
+        r.mtime = entries.modifiedTime(i);
+        r.name_offset = listing->names.size();
+        r.mode = entries.mode(i);
+        r.name_length = std::min(entries.nameLength(i), (size_t)UINT16_MAX);
+        r.type = entries.type(i);
+        r.is_link = entries.isLink(i);
+        listing->names.insert(listing->names.end(), entries.name(i), entries.name(i) + r.name_length);
+    }
+    std::map<Key, Listing *>::iterator old = stored.find(key);
+    if(old != stored.end()){
+        delete old->second;
+        old->second = listing;
+    } else {
+        stored[key] = listing;
+    }
+    used[key] = time(NULL);
+}
+
+//the new file holds this run's listings plus the old ones still worth
+//keeping, most recently used first until CACHE_MAX_BYTES is reached
+bool MetaCache::save(){
+    struct Source {
+        FolderRecord record;     //offsets still point into the source
+        const void *entries;
+        const void *names;
+    };
+    std::vector<Source> sources;
+    for(std::map<Key, Listing *>::iterator it = stored.begin(); it != stored.end(); ++it){
+        Source s;
+        memset(&s.record, 0, sizeof(s.record));
+        s.record.dev = it->first.first;
+        s.record.ino = it->first.second;
+        s.record.mtime_ns = it->second->stamp.mtime_ns;
+        s.record.last_used = used[it->first];
+        s.record.entry_count = it->second->entries.size();
+        s.record.names_size = it->second->names.size();
+        s.entries = it->second->entries.data();
+        s.names = it->second->names.data();
+        sources.push_back(s);
+    }
+    for(uint32_t i = 0; i < folder_count; i++){
+        Key key(folders[i].dev, folders[i].ino);
+        if(stored.count(key) != 0 || !valid(&folders[i])){
+            continue; //replaced this run, or damaged
+        }
+        Source s;
+        s.record = folders[i];
+        std::map<Key, uint64_t>::iterator shown = used.find(key);
+        if(shown != used.end()){
+            s.record.last_used = shown->second;
+        }
+        s.entries = data + folders[i].entries_offset;
+        s.names = data + folders[i].names_offset;
+        sources.push_back(s);
+    }
+
+    std::sort(sources.begin(), sources.end(), [](const Source &a, const Source &b){
+        return a.record.last_used > b.record.last_used;
+    });
+    size_t total = sizeof(Header);
+    size_t keep = 0;
+    for(; keep < sources.size(); keep++){
+        size_t names_padded = (sources[keep].record.names_size + 7) & ~(size_t)7;
+        size_t bytes = sizeof(FolderRecord) + sources[keep].record.entry_count * sizeof(EntryRecord) + names_padded;
+        if(total + bytes > CACHE_MAX_BYTES){
+            break;
+        }
+        total += bytes;
+    }
+    sources.resize(keep);
+    std::sort(sources.begin(), sources.end(), [](const Source &a, const Source &b){
+        return a.record.dev < b.record.dev || (a.record.dev == b.record.dev && a.record.ino < b.record.ino);
+    });
+
+    //lay the file out in memory, then write it in one go
+    std::vector<unsigned char> out(total, 0);
+    Header *header = (Header *)out.data();
+    memcpy(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header->version = CACHE_VERSION;
+    header->folder_count = sources.size();
+    header->file_size = total;
+    FolderRecord *table = (FolderRecord *)(out.data() + sizeof(Header));
+    size_t pos = sizeof(Header) + sources.size() * sizeof(FolderRecord);
+    for(size_t i = 0; i < sources.size(); i++){
+        FolderRecord record = sources[i].record;
+        size_t entries_size = record.entry_count * sizeof(EntryRecord);
+        record.entries_offset = pos;
+        memcpy(&out[pos], sources[i].entries, entries_size);
+        pos += entries_size;
+        record.names_offset = pos;
+        memcpy(&out[pos], sources[i].names, record.names_size);
+        pos += (record.names_size + 7) & ~(size_t)7;
+        record.checksum = checksum(&out[record.entries_offset], entries_size);
+        record.checksum = checksum(&out[record.names_offset], record.names_size, record.checksum);
+        table[i] = record;
+    }
+    header->table_checksum = checksum(table, sources.size() * sizeof(FolderRecord));
+
+    std::string dir = file.substr(0, file.rfind('/'));
+    std::string parent = dir.substr(0, dir.rfind('/'));
+    mkdir(parent.c_str(), 0700);
+    mkdir(dir.c_str(), 0700);
+    std::string temp = file + ".tmp." + std::to_string(getpid());
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if(fd < 0){
+        return false;
+    }
+    size_t written = 0;
+    while(written < out.size()){
+        ssize_t n = write(fd, out.data() + written, out.size() - written);
+        if(n < 0 && errno == EINTR){
+            continue;
+        }
+        if(n <= 0){
+            break;
+        }
+        written += n;
+    }
+    close(fd);
+    //readers holding the old file keep their mapping, rename swaps atomically
+    if(written != out.size() || rename(temp.c_str(), file.c_str()) != 0){
+        unlink(temp.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "namefilter.h"
+#include "entrystore.h"
+
+void foldName(const char *name, size_t len, char *out){
+    for(size_t i = 0; i < len; i++){
+        char c = name[i];
+        out[i] = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+}
+
+#ifdef __SSE2__
+//compares the needle's first and last byte against 16 positions at once,
+//only positions where both agree get a memcmp of the middle
+long findFolded(const char *hay, size_t len, const char *needle, size_t needle_len){
+    if(needle_len == 0){
+        return 0;
+    }
+    if(needle_len > len){
+        return -1;
+    }
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[needle_len - 1]);
+    size_t positions = len - needle_len + 1;
+    size_t middle = needle_len > 2 ? needle_len - 2 : 0;
+    for(size_t i = 0; i < positions; i += 16){
+        __m128i block_first = _mm_loadu_si128((const __m128i *)(hay + i));
+        __m128i block_last = _mm_loadu_si128((const __m128i *)(hay + i + needle_len - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, block_first),
+                                                        _mm_cmpeq_epi8(last, block_last)));
+        while(mask != 0){
+            unsigned bit = __builtin_ctz(mask);
+            if(i + bit >= positions){
+                return -1; //past the end, the rest of the block is padding
+            }
+            const char *at = hay + i + bit + 1;
+            size_t k = 0;
+            while(k < middle && at[k] == needle[k + 1]){
+                k++; //names are short, a call to memcmp costs more than this
+            }
+            if(k == middle){
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return -1;
+}
+#else
+long findFolded(const char *hay, size_t len, const char *needle, size_t needle_len){
+    const char *found = std::search(hay, hay + len, needle, needle + needle_len);
+    return found == hay + len && needle_len > 0 ? -1 : found - hay;
+}
+#endif
+
+static inline uint32_t trigramBucket(const char *p){
+    uint32_t trigram = (unsigned char)p[0] | (unsigned char)p[1] << 8 | (unsigned char)p[2] << 16;
+    return (trigram * 2654435761u) >> 16;
+}
+
+void NameIndex::clear(){
+    version = 0;
+    folded.clear();
+    offsets.clear();
+    has_trigrams = false;
+    bucket_starts.clear();
+    postings.clear();
+    last_query.clear();
+    last_matches.clear();
+}
+
+void NameIndex::rebuild(const EntryStore &store){
+    clear();
+    size_t bytes = 0;
+    for(size_t i = 0; i < store.size(); i++){
+        bytes += store.nameLength(i) + 1;
+    }
+    folded.resize(bytes + FILTER_PADDING);
+    offsets.resize(store.size() + 1);
+    char *out = folded.data();
+    for(size_t i = 0; i < store.size(); i++){
+        offsets[i] = out - folded.data();
+        foldName(store.name(i), store.nameLength(i), out);
+        out += store.nameLength(i);
+        *out++ = '\0'; //no query contains one, so no match spans two names
+    }
+    offsets[store.size()] = out - folded.data();
+    memset(out, 0, FILTER_PADDING);
+    version = store.version();
+}
+
+//varint of the gap to the previous entry of the same bucket: most gaps in a
+//busy bucket are small, so most postings cost a byte instead of four
+static inline size_t varintSize(uint32_t v){
+    size_t bytes = 1;
+    while(v >= 0x80){
+        v >>= 7;
+        bytes++;
+    }
+    return bytes;
+}
+
+static inline unsigned char *putVarint(unsigned char *out, uint32_t v){
+    while(v >= 0x80){
+        *out++ = (v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    *out++ = v;
+    return out;
+}
+
+//walks the entries of one bucket in ascending order
+struct PostingReader {
+    const unsigned char *pos;
+    const unsigned char *end;
+    uint32_t last; //entry + 1, 0 before the first
+
+    PostingReader(const unsigned char *from, const unsigned char *to) : pos(from), end(to), last(0) {}
+    bool next(uint32_t *entry){
+        if(pos == end){
+            return false;
+        }
+        uint32_t gap = 0;
+        for(int shift = 0; ; shift += 7){
+            unsigned char byte = *pos++;
+            gap |= (uint32_t)(byte & 0x7F) << shift;
+            if(byte < 0x80){
+                break;
+            }
+        }
+        last += gap;
+        *entry = last - 1;
+        return true;
+    }
+};
+
+//two passes over the names: size every bucket, then fill them. a name only
+//lands once in a bucket however often its trigrams hash there.
+void NameIndex::buildTrigrams(){
+    size_t count = offsets.size() - 1;
+    std::vector<uint32_t> last(FILTER_TRIGRAM_BUCKETS); //entry + 1 last put in each bucket
+    std::vector<uint32_t> cursor(FILTER_TRIGRAM_BUCKETS + 1, 0);
+    for(int pass = 0; pass < 2; pass++){
+        std::fill(last.begin(), last.end(), 0);
+        for(size_t i = 0; i < count; i++){
+            const char *name = &folded[offsets[i]];
+            size_t len = offsets[i + 1] - offsets[i] - 1;
+            for(size_t j = 0; j + 3 <= len; j++){
+                uint32_t b = trigramBucket(name + j);
+                if(last[b] == i + 1){
+                    continue;
+                }
+                uint32_t gap = i + 1 - last[b];
+                last[b] = i + 1;
+                if(pass == 0){
+                    cursor[b + 1] += varintSize(gap);
+                } else {
+                    cursor[b] = putVarint(&postings[cursor[b]], gap) - postings.data();
+                }
+            }
+        }
+        if(pass == 0){
+            for(size_t b = 0; b < FILTER_TRIGRAM_BUCKETS; b++){
+                cursor[b + 1] += cursor[b];
+            }
+            bucket_starts = cursor;
+            postings.resize(cursor[FILTER_TRIGRAM_BUCKETS]);
+        }
+    }
+    has_trigrams = true;
+}
+
+//entries that have every trigram of query (or a hash twin of it). the
+//shortest posting list is the start, the others only ever shrink it.
+void NameIndex::candidates(const std::string &query, std::vector<uint32_t> *out) const {
+    std::vector<uint32_t> buckets;
+    for(size_t j = 0; j + 3 <= query.size(); j++){
+        buckets.push_back(trigramBucket(query.data() + j));
+    }
+    std::sort(buckets.begin(), buckets.end());
+    buckets.erase(std::unique(buckets.begin(), buckets.end()), buckets.end());
+    std::sort(buckets.begin(), buckets.end(), [this](uint32_t a, uint32_t b){
+        return bucket_starts[a + 1] - bucket_starts[a] < bucket_starts[b + 1] - bucket_starts[b];
+    });
+
+    out->clear();
+    PostingReader first(postings.data() + bucket_starts[buckets[0]], postings.data() + bucket_starts[buckets[0] + 1]);
+    uint32_t entry;
+    while(first.next(&entry)){
+        out->push_back(entry);
+    }
+    for(size_t b = 1; b < buckets.size() && !out->empty(); b++){
+        PostingReader list(postings.data() + bucket_starts[buckets[b]], postings.data() + bucket_starts[buckets[b] + 1]);
+        size_t kept = 0;
+        bool more = list.next(&entry);
+        for(size_t k = 0; k < out->size() && more; k++){
+            while(more && entry < (*out)[k]){
+                more = list.next(&entry);
+            }
+            if(more && entry == (*out)[k]){
+                (*out)[kept++] = entry;
+            }
+        }
+        out->resize(kept);
+    }
+}
+
+void NameIndex::prepare(const EntryStore &store){
+    if(store.version() != version){
+        rebuild(store);
+    }
+    if(!has_trigrams && store.size() >= FILTER_INDEX_MIN){
+        buildTrigrams();
+    }
+}
+
+void NameIndex::match(const EntryStore &store, const std::string &query, std::vector<uint32_t> *matches){
+    if(store.version() != version){
+        rebuild(store);
+    }
+    std::string needle(query.size(), '\0');
+    foldName(query.data(), query.size(), &needle[0]);
+    matches->clear();
+
+    const std::vector<uint32_t> *look_at = NULL; //NULL means every name
+    std::vector<uint32_t> found;
+    if(!last_query.empty() && needle.find(last_query) != std::string::npos){
+        look_at = &last_matches; //narrower than anything else
+    } else if(needle.size() >= 3 && offsets.size() - 1 >= FILTER_INDEX_MIN){
+        if(!has_trigrams){
+            buildTrigrams();
+        }
+        candidates(needle, &found);
+        look_at = &found;
+    }
+
+    if(look_at != NULL){
+        for(size_t k = 0; k < look_at->size(); k++){
+            uint32_t i = (*look_at)[k];
+            if(findFolded(&folded[offsets[i]], offsets[i + 1] - offsets[i] - 1, needle.data(), needle.size()) >= 0){
+                matches->push_back(i);
+            }
+        }
+    } else {
+        //one pass over the whole arena, skipping to the next name after a hit
+        size_t end = offsets.back();
+        size_t pos = 0;
+        uint32_t i = 0;
+        long hit;
+        while(pos < end && (hit = findFolded(&folded[pos], end - pos, needle.data(), needle.size())) >= 0){
+            size_t at = pos + hit;
+            while(offsets[i + 1] <= at){
+                i++; //hits only move forward, so does the name they are in
+            }
+            matches->push_back(i);
+            pos = offsets[++i];
+        }
+    }
+
+    last_query = needle;
+    last_matches = *matches;
+}
+
+size_t NameIndex::memoryUsage() const {
+    return folded.capacity() + offsets.capacity() * sizeof(uint32_t)
+         + (bucket_starts.capacity() + last_matches.capacity()) * sizeof(uint32_t) + postings.capacity();
+}
@@ -0,0 +1,101 @@
+#include <utility>
+#include "resourcepool.h"
+#include "trace.h"
+
+TextureHandle::TextureHandle(TextureHandle &&other) : pool(other.pool), texture(other.texture), bytes(other.bytes){
+    other.texture = NULL;
+}
+
+TextureHandle &TextureHandle::operator=(TextureHandle &&other){
+    if(this != &other){
+        reset();
+        std::swap(pool, other.pool);
+        std::swap(texture, other.texture);
+        std::swap(bytes, other.bytes);
+    }
+    return *this;
+}
+
+void TextureHandle::reset(){
+    if(texture == NULL){
+        return;
+    }
+    SDL_DestroyTexture(texture);
+    texture = NULL;
+    pool->live.textures--;
+    pool->live.texture_bytes -= bytes;
+    bytes = 0;
+}
+
+FontHandle::FontHandle(FontHandle &&other) : pool(other.pool), font(other.font){
+    other.font = NULL;
+}
+
+FontHandle &FontHandle::operator=(FontHandle &&other){
+    if(this != &other){
+        reset();
+        std::swap(pool, other.pool);
+        std::swap(font, other.font);
+    }
+    return *this;
+}
+
+void FontHandle::reset(){
+    if(font == NULL){
+        return;
+    }
+    TTF_CloseFont(font);
+    font = NULL;
+    pool->live.fonts--;
+}
+
+ResourcePool::ResourcePool(size_t budget){
+    live.textures = 0;
+    live.texture_bytes = 0;
+    live.peak_bytes = 0;
+    live.budget = budget;
+    live.fonts = 0;
+    live.refused = 0;
+}
+
+TextureHandle ResourcePool::adopt(SDL_Texture *texture){
+    if(texture == NULL){
+        return TextureHandle();
+    }
+    Uint32 format;
+    int access, w, h;
+    SDL_QueryTexture(texture, &format, &access, &w, &h);
+    size_t bytes = (size_t)w * h * SDL_BYTESPERPIXEL(format);
+    TRACE_COUNT(TRACE_TEXTURES, 1);
+    live.textures++;
+    live.texture_bytes += bytes;
+    if(live.texture_bytes > live.peak_bytes){
+        live.peak_bytes = live.texture_bytes;
+    }
+    return TextureHandle(this, texture, bytes);
+}
+
+TextureHandle ResourcePool::createTexture(SDL_Renderer *renderer, Uint32 format, int access, int w, int h){
+    return adopt(SDL_CreateTexture(renderer, format, access, w, h));
+}
+
+TextureHandle ResourcePool::createTexture(SDL_Renderer *renderer, SDL_Surface *surface){
+    return adopt(SDL_CreateTextureFromSurface(renderer, surface));
+}
+
+FontHandle ResourcePool::openFont(const char *path, int pt_size){
+    TTF_Font *font = TTF_OpenFont(path, pt_size);
+    if(font == NULL){
+        return FontHandle();
+    }
+    live.fonts++;
+    return FontHandle(this, font);
+}
+
+bool ResourcePool::fits(size_t bytes){
+    if(live.texture_bytes + bytes <= live.budget){
+        return true;
+    }
+    live.refused++;
+    return false;
+}
@@ -0,0 +1,175 @@
+#include "scanner.h"
+#include "asyncstat.h"
+#include "trace.h"
+
+#include <iterator>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define SCAN_BUFFER_SIZE (256 * 1024)
+#define NAMES_BUFFER_SIZE (32 * 1024)
+
+//layout the kernel hands back from getdents64, glibc does not export it everywhere
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+//turns the answer to a stat job into the entry's kind, size, mode and mtime
+static void applyStat(int dirfd, const StatJob &job, ScanEntry *entry){
+    entry->size = job.size;
+    entry->mode = job.mode;
+    entry->mtime = job.mtime;
+
+    if(!job.ok){
+        entry->size = 0;
+        entry->mode = 0;
+        entry->mtime = 0;
+        if(job.follow && statAt(dirfd, job.name, false, &entry->size, &entry->mode, &entry->mtime)){
+            //dangling symlink, keep what lstat says about the link itself
+            if(S_ISLNK(entry->mode)){
+                entry->is_link = true;
+            }
+        }
+        entry->kind = SCAN_OTHER;
+        return;
+    }
+
+    if(S_ISDIR(entry->mode)){
+        entry->kind = SCAN_DIR;
+    } else if(S_ISREG(entry->mode)){
+        entry->kind = SCAN_FILE;
+    } else {
+        entry->kind = SCAN_OTHER;
+    }
+}
+
+//metadata for everything in the batch that is not known to be a folder, all at
+//once so slow filesystems get many requests in flight. links and DT_UNKNOWN
+//(xfs/nfs) have to be resolved to be classified at all.
+static void resolveBatch(int dirfd, std::vector<ScanEntry> *batch){
+    std::vector<StatJob> jobs;
+    std::vector<int> job_entry;
+    for(int i = 0; i < batch->size(); i++){
+        ScanEntry *entry = &(*batch)[i];
+        if(entry->d_type == DT_DIR){
+            continue;
+        }
+        StatJob job;
+        job.name = entry->name.c_str();
+        job.follow = (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN);
+        jobs.push_back(job);
+        job_entry.push_back(i);
+    }
+    statJobs(dirfd, &jobs);
+    for(int i = 0; i < jobs.size(); i++){
+        applyStat(dirfd, jobs[i], &(*batch)[job_entry[i]]);
+    }
+}
+
+bool scanDirectoryBatched(const std::string &dirpath, const ScanBatchCallback &deliver){
+    TRACE_SCOPE("scanDirectory");
+    TRACE_COUNT(TRACE_SYSCALLS, 1);
+    int dirfd = open(dirpath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(dirfd < 0){
+        return false;
+    }
+
+    std::vector<ScanEntry> batch;
+    char *buffer = new char[SCAN_BUFFER_SIZE];
+    while(true){
+        long nread = syscall(SYS_getdents64, dirfd, buffer, SCAN_BUFFER_SIZE);
+        TRACE_COUNT(TRACE_SYSCALLS, 1);
+        if(nread <= 0){
+            break; //end of directory or error, keep what we have
+        }
+
+        long pos = 0;
+        while(pos < nread){
+            struct linux_dirent64 *dent = (struct linux_dirent64 *)(buffer + pos);
+            pos += dent->d_reclen;
+
+            if(dent->d_name[0] == '.' && dent->d_name[1] == '\0'){
+                continue;
+            }
+
+            ScanEntry entry;
+            entry.name = dent->d_name;
+            entry.d_type = dent->d_type;
+            entry.kind = SCAN_DIR;
+            entry.is_link = (dent->d_type == DT_LNK);
+            entry.size = 0;
+            entry.mode = 0;
+            entry.mtime = 0;
+            batch.push_back(entry);
+        }
+
+        resolveBatch(dirfd, &batch);
+        if(!deliver(batch)){
+            break; //caller lost interest
+        }
+        batch.clear();
+    }
+    delete[] buffer;
+
+    close(dirfd);
+    TRACE_COUNT(TRACE_SYSCALLS, 1);
+    return true;
+}
+
+bool scanDirectory(const std::string &dirpath, std::vector<ScanEntry> *entries){
+    entries->clear();
+    return scanDirectoryBatched(dirpath, [entries](std::vector<ScanEntry> &batch){
+        entries->insert(entries->end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+        return true;
+    });
+}
+
+bool scanEntryAt(int dirfd, const char *name, ScanEntry *entry){
+    uint64_t size;
+    mode_t mode;
+    int64_t mtime;
+    if(!statAt(dirfd, name, false, &size, &mode, &mtime)){
+        return false;
+    }
+    entry->name = name;
+    entry->d_type = IFTODT(mode);
+    entry->is_link = S_ISLNK(mode);
+
+    StatJob job;
+    job.name = name;
+    job.follow = entry->is_link;
+    job.ok = true;
+    job.size = size;
+    job.mode = mode;
+    job.mtime = mtime;
+    if(job.follow){
+        job.ok = statAt(dirfd, name, true, &job.size, &job.mode, &job.mtime);
+    }
+    applyStat(dirfd, job, entry);
+    return true;
+}
+
+bool listNames(int dirfd, const NameCallback &visit){
+    char buffer[NAMES_BUFFER_SIZE]; //called per folder in big walks, no heap round trip
+    long nread;
+    while((nread = syscall(SYS_getdents64, dirfd, buffer, sizeof(buffer))) > 0){
+        for(long pos = 0; pos < nread; ){
+            struct linux_dirent64 *dent = (struct linux_dirent64 *)(buffer + pos);
+            pos += dent->d_reclen;
+            const char *name = dent->d_name;
+            if(name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))){
+                continue;
+            }
+            visit(name, dent->d_type);
+        }
+    }
+    return nread == 0;
+}
@@ -0,0 +1,133 @@
+#include <chrono>
+#include "scanworker.h"
+
+#define SCAN_QUEUE_SIZE 64
+
+ScanWorker::ScanWorker(std::function<void()> wake_fn)
+    : wake(wake_fn), results(SCAN_QUEUE_SIZE), generation(0), has_pending(false), quitting(false)
+{
+    thread = std::thread(&ScanWorker::run, this);
+}
+
+ScanWorker::~ScanWorker(){
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        quitting = true;
+        generation++;
+    }
+    wakeup.notify_one();
+    thread.join();
+
+    ScanBatch *batch;
+    while(results.pop(&batch)){
+        delete batch;
+    }
+}
+
+unsigned ScanWorker::start(const std::string &path, const SortOrder &order){
+    unsigned gen;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        gen = ++generation; //a running scan sees this and stops
+        pending_path = path;
+        pending_order = order;
+        has_pending = true;
+    }
+    wakeup.notify_one();
+    return gen;
+}
+
+void ScanWorker::cancel(){
+    std::lock_guard<std::mutex> guard(lock);
+    generation++;
+    has_pending = false;
+}
+
+void ScanWorker::setOrder(const SortOrder &order){
+    std::lock_guard<std::mutex> guard(lock);
+    pending_order = order;
+}
+
+SortOrder ScanWorker::currentOrder(){
+    std::lock_guard<std::mutex> guard(lock);
+    return pending_order;
+}
+
+bool ScanWorker::poll(ScanBatch **batch){
+    return results.pop(batch);
+}
+
+//pushes a batch, waiting for room while the scan is still wanted
+bool ScanWorker::deliver(ScanBatch *batch, unsigned gen){
+    while(!results.push(batch)){
+        if(generation.load() != gen){
+            delete batch;
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    wake();
+    return true;
+}
+
+void ScanWorker::run(){
+    while(true){
+        std::string path;
+        SortOrder order;
+        unsigned gen;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wakeup.wait(guard, [this]{ return has_pending || quitting; });
+            if(quitting){
+                return;
+            }
+            path = pending_path;
+            order = pending_order;
+            gen = generation.load();
+            has_pending = false;
+        }
+
+        //entries read since the last listing went out are kept unsorted and
+        //merged in one go, the listing at least doubles each time
+        EntryStore listing, unsent;
+        listing.sort(order);
+        auto catchUp = [&](){
+            SortOrder now = currentOrder();
+            if(now != listing.sortOrder()){
+                listing.sort(now); //re-sorted while it was being read
+            }
+            unsent.sort(now);
+            listing.mergeSorted(unsent);
+        };
+        bool wanted = true;
+        scanDirectoryBatched(path, [&](std::vector<ScanEntry> &entries){
+            if(generation.load() != gen){
+                wanted = false; //user navigated away
+                return false;
+            }
+            for(int i = 0; i < entries.size(); i++){
+                addScanEntry(&unsent, entries[i]);
+            }
+            if(unsent.size() < listing.size()){
+                return true;
+            }
+            catchUp();
+            ScanBatch *batch = new ScanBatch;
+            batch->generation = gen;
+            batch->done = false;
+            batch->entries = listing;
+            wanted = deliver(batch, gen);
+            return wanted;
+        });
+
+        if(wanted){
+            catchUp();
+            //the complete listing, also when the folder could not be read
+            ScanBatch *last = new ScanBatch;
+            last->generation = gen;
+            last->done = true;
+            last->entries = std::move(listing);
+            deliver(last, gen);
+        }
+    }
+}
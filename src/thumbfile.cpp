@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <vector>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "thumbfile.h"
+
+//MD5 (RFC 1321), only ever fed a URI
+static const uint32_t MD5_K[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+static const int MD5_SHIFT[16] = { 7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21 };
+
+std::string md5Hex(const std::string &data){
+    std::vector<unsigned char> message(data.begin(), data.end());
+    uint64_t bits = (uint64_t)data.size() * 8;
+    message.push_back(0x80);
+    while(message.size() % 64 != 56){
+        message.push_back(0);
+    }
+    for(int i = 0; i < 8; i++){
+        message.push_back(bits >> (8 * i));
+    }
+
+    uint32_t h[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+    for(size_t block = 0; block < message.size(); block += 64){
+        uint32_t m[16];
+        for(int i = 0; i < 16; i++){
+            const unsigned char *p = &message[block + i * 4];
+            m[i] = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+        for(int i = 0; i < 64; i++){
+            uint32_t f;
+            int g;
+            if(i < 16){
+                f = (b & c) | (~b & d);
+                g = i;
+            } else if(i < 32){
+                f = (d & b) | (~d & c);
+                g = (5 * i + 1) % 16;
+            } else if(i < 48){
+                f = b ^ c ^ d;
+                g = (3 * i + 5) % 16;
+            } else {
+                f = c ^ (b | ~d);
+                g = (7 * i) % 16;
+            }
+            uint32_t rotate = a + f + MD5_K[i] + m[g];
+            int s = MD5_SHIFT[(i / 16) * 4 + i % 4];
+            a = d;
+            d = c;
+            c = b;
+            b = b + ((rotate << s) | (rotate >> (32 - s)));
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+    }
+
+    char hex[33];
+    for(int i = 0; i < 16; i++){
+        snprintf(hex + i * 2, 3, "%02x", (h[i / 4] >> (8 * (i % 4))) & 0xff);
+    }
+    return hex;
+}
+
+std::string thumbnailUri(const std::string &path){
+    static const char *digits = "0123456789ABCDEF";
+    std::string uri = "file://";
+    for(size_t i = 0; i < path.size(); i++){
+        unsigned char c = path[i];
+        if(isalnum(c) || strchr("/-_.~!$&'()*+,;=:@", c) != NULL){
+            uri += c;
+        } else {
+            uri += '%';
+            uri += digits[c >> 4];
+            uri += digits[c & 15];
+        }
+    }
+    return uri;
+}
+
+std::string thumbnailFile(const std::string &uri){
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    std::string dir;
+    if(xdg != NULL && xdg[0] == '/'){
+        dir = xdg;
+    } else {
+        const char *home = getenv("HOME");
+        dir = std::string(home != NULL ? home : "") + "/.cache";
+    }
+    return dir + "/thumbnails/normal/" + md5Hex(uri) + ".png";
+}
+
+static uint32_t readBigEndian(const unsigned char *p){
+    return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+int64_t thumbnailMTime(const std::string &file){
+    //the text chunks come before the pixels, the first few KB hold them
+    unsigned char head[8192];
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        return -1;
+    }
+    ssize_t got = read(fd, head, sizeof(head));
+    close(fd);
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    if(got < 8 || memcmp(head, signature, 8) != 0){
+        return -1;
+    }
+    size_t pos = 8;
+    while(pos + 8 <= (size_t)got){
+        uint32_t len = readBigEndian(head + pos);
+        const unsigned char *type = head + pos + 4;
+        const char *body = (const char *)head + pos + 8;
+        if(memcmp(type, "IDAT", 4) == 0 || len > (size_t)got - pos - 8){
+            break;
+        }
+        static const char key[] = "Thumb::MTime";
+        if(memcmp(type, "tEXt", 4) == 0 && len > sizeof(key) && memcmp(body, key, sizeof(key)) == 0){
+            std::string value(body + sizeof(key), len - sizeof(key));
+            return strtoll(value.c_str(), NULL, 10);
+        }
+        pos += 12 + len;
+    }
+    return -1;
+}
+
+struct CrcTable {
+    uint32_t entries[256];
+    CrcTable(){
+        for(uint32_t n = 0; n < 256; n++){
+            uint32_t c = n;
+            for(int k = 0; k < 8; k++){
+                c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            }
+            entries[n] = c;
+        }
+    }
+};
+
+static uint32_t crc32(const unsigned char *data, size_t len, uint32_t crc = 0){
+    static const CrcTable table; //built once, even with several decode threads asking at the same time
+    crc = ~crc;
+    for(size_t i = 0; i < len; i++){
+        crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void putBigEndian(std::vector<unsigned char> *out, uint32_t v){
+    out->push_back(v >> 24);
+    out->push_back(v >> 16);
+    out->push_back(v >> 8);
+    out->push_back(v);
+}
+
+static void putChunk(std::vector<unsigned char> *out, const char *type, const std::vector<unsigned char> &body){
+    putBigEndian(out, body.size());
+    size_t start = out->size();
+    out->insert(out->end(), type, type + 4);
+    out->insert(out->end(), body.begin(), body.end());
+    putBigEndian(out, crc32(&(*out)[start], out->size() - start));
+}
+
+static void putText(std::vector<unsigned char> *out, const char *key, const std::string &value){
+    std::vector<unsigned char> body(key, key + strlen(key) + 1); //NUL separates key and text
+    body.insert(body.end(), value.begin(), value.end());
+    putChunk(out, "tEXt", body);
+}
+
+//the pixels go in as stored (uncompressed) deflate blocks: a thumbnail is
+//small, and it saves pulling in zlib for one file format
+bool writeThumbnail(const std::string &file, const uint32_t *pixels, int w, int h,
+                    const std::string &uri, int64_t mtime){
+    std::vector<unsigned char> raw;
+    raw.reserve((size_t)h * (w * 4 + 1));
+    for(int y = 0; y < h; y++){
+        raw.push_back(0); //no filter
+        for(int x = 0; x < w; x++){
+            uint32_t p = pixels[(size_t)y * w + x];
+            raw.push_back(p >> 16);
+            raw.push_back(p >> 8);
+            raw.push_back(p);
+            raw.push_back(p >> 24);
+        }
+    }
+    std::vector<unsigned char> zlib;
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    for(size_t pos = 0; pos < raw.size() || pos == 0; ){
+        size_t len = std::min(raw.size() - pos, (size_t)65535);
+        zlib.push_back(pos + len == raw.size() ? 1 : 0); //last block flag, stored type
+        zlib.push_back(len & 0xff);
+        zlib.push_back(len >> 8);
+        zlib.push_back(~len & 0xff);
+        zlib.push_back((~len >> 8) & 0xff);
+        zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + len);
+        pos += len;
+        if(len == 0){
+            break;
+        }
+    }
+    uint32_t a = 1, b = 0; //adler32
+    for(size_t i = 0; i < raw.size(); i++){
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    putBigEndian(&zlib, b << 16 | a);
+
+    std::vector<unsigned char> png;
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    png.insert(png.end(), signature, signature + 8);
+    std::vector<unsigned char> header;
+    putBigEndian(&header, w);
+    putBigEndian(&header, h);
+    header.push_back(8); //bits per channel
+    header.push_back(6); //RGBA
+    header.push_back(0);
+    header.push_back(0);
+    header.push_back(0);
+    putChunk(&png, "IHDR", header);
+    putText(&png, "Thumb::URI", uri);
+    putText(&png, "Thumb::MTime", std::to_string(mtime));
+    putText(&png, "Software", "os-fileexplorer");
+    putChunk(&png, "IDAT", zlib);
+    putChunk(&png, "IEND", std::vector<unsigned char>());
+
+    //the spec wants the folders private
+    std::string dir = file.substr(0, file.rfind('/'));
+    std::string thumbnails = dir.substr(0, dir.rfind('/'));
+    mkdir(thumbnails.substr(0, thumbnails.rfind('/')).c_str(), 0700);
+    mkdir(thumbnails.c_str(), 0700);
+    mkdir(dir.c_str(), 0700);
+    std::string temp = file + ".tmp." + std::to_string(getpid());
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if(fd < 0){
+        return false;
+    }
+    bool ok = write(fd, png.data(), png.size()) == (ssize_t)png.size();
+    close(fd);
+    if(!ok || rename(temp.c_str(), file.c_str()) != 0){
+        unlink(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+void fitSize(int w, int h, int max, int *fit_w, int *fit_h){
+    if(w <= max && h <= max){
+        *fit_w = w;
+        *fit_h = h;
+    } else if(w >= h){
+        *fit_w = max;
+        *fit_h = std::max(1, (int)((int64_t)h * max / w));
+    } else {
+        *fit_h = max;
+        *fit_w = std::max(1, (int)((int64_t)w * max / h));
+    }
+}
+
+void shrinkPixels(const uint32_t *src, int sw, int sh, int pitch, uint32_t *dst, int dw, int dh){
+    for(int y = 0; y < dh; y++){
+        int y0 = (int64_t)y * sh / dh;
+        int y1 = std::max(y0 + 1, (int)((int64_t)(y + 1) * sh / dh));
+        for(int x = 0; x < dw; x++){
+            int x0 = (int64_t)x * sw / dw;
+            int x1 = std::max(x0 + 1, (int)((int64_t)(x + 1) * sw / dw));
+            uint64_t sum[4] = { 0, 0, 0, 0 };
+            for(int sy = y0; sy < y1; sy++){
+                const uint32_t *row = src + (size_t)sy * pitch;
+                for(int sx = x0; sx < x1; sx++){
+                    uint32_t p = row[sx];
+                    sum[0] += p >> 24;
+                    sum[1] += (p >> 16) & 0xff;
+                    sum[2] += (p >> 8) & 0xff;
+                    sum[3] += p & 0xff;
+                }
+            }
+            uint64_t n = (uint64_t)(y1 - y0) * (x1 - x0);
+            dst[(size_t)y * dw + x] = (uint32_t)(sum[0] / n) << 24 | (uint32_t)(sum[1] / n) << 16
+                                    | (uint32_t)(sum[2] / n) << 8 | (uint32_t)(sum[3] / n);
+        }
+    }
+}
@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <SDL_image.h>
+#include "thumbnails.h"
+#include "thumbfile.h"
+#include "trace.h"
+
+ThumbnailCache::ThumbnailCache(ResourcePool *pool, std::function<void()> wake_fn, unsigned thread_count)
+    : wake(wake_fn), persist(true), decoding(0), frame(0), quitting(false), pool(pool), placed(0)
+{
+    if(thread_count == 0){
+        unsigned cores = std::thread::hardware_concurrency();
+        thread_count = std::min(4u, cores > 1 ? cores - 1 : 1u);
+    }
+    for(unsigned t = 0; t < thread_count; t++){
+        threads.push_back(std::thread(&ThumbnailCache::run, this));
+    }
+}
+
+ThumbnailCache::~ThumbnailCache(){
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        quitting = true;
+        queue.clear();
+    }
+    work_ready.notify_all();
+    for(int t = 0; t < threads.size(); t++){
+        threads[t].join();
+    }
+    for(int i = 0; i < ready.size(); i++){
+        delete ready[i];
+    }
+    for(std::unordered_map<std::string, Parked>::iterator it = parked.begin(); it != parked.end(); ++it){
+        delete it->second.decoded;
+    }
+}
+
+bool ThumbnailCache::draw(SDL_Renderer *renderer, const std::string &path, int64_t mtime, const SDL_Rect *dest){
+    std::unordered_map<std::string, Entry>::iterator known = entries.find(path);
+    if(known != entries.end() && known->second.mtime != mtime){
+        dropEntry(path); //changed since, decode it again
+        known = entries.end();
+    }
+    std::unordered_map<std::string, Parked>::iterator waiting = parked.find(path);
+    if(known == entries.end() && waiting != parked.end()){
+        Decoded *decoded = waiting->second.decoded;
+        waiting->second.used = frame;
+        if(decoded->mtime != mtime){
+            parked.erase(waiting);
+            delete decoded; //changed since, asked for again below
+        } else if(placed >= THUMB_UPLOADS_PER_FRAME){
+            return false;
+        } else {
+            parked.erase(waiting);
+            place(renderer, decoded); //parks it again if still no cell is free
+            known = entries.find(path);
+            if(known == entries.end()){
+                return false;
+            }
+        }
+    }
+    if(known != entries.end()){
+        if(known->second.slot < 0){
+            return false;
+        }
+        Slot &slot = slots[known->second.slot];
+        slot.used = frame;
+        //centered in dest, aspect kept
+        float scale = std::min((float)dest->w / slot.cell.w, (float)dest->h / slot.cell.h);
+        int w = std::max(1, (int)(slot.cell.w * scale));
+        int h = std::max(1, (int)(slot.cell.h * scale));
+        SDL_Rect to = { dest->x + (dest->w - w) / 2, dest->y + (dest->h - h) / 2, w, h };
+        SDL_RenderCopy(renderer, pages[slot.page].get(), &slot.cell, &to);
+        TRACE_COUNT(TRACE_DRAW_CALLS, 1);
+        return true;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    std::unordered_map<std::string, unsigned>::iterator pending = wanted.find(path);
+    if(pending != wanted.end()){
+        pending->second = frame; //still on screen, keep it
+        return false;
+    }
+    if(parked.size() >= THUMB_PARKED_MAX){
+        return false; //no room for more than are waiting already
+    }
+    wanted[path] = frame;
+    Request request;
+    request.path = path;
+    request.mtime = mtime;
+    queue.push_front(request);
+    if(queue.size() > THUMB_QUEUE_MAX){
+        wanted.erase(queue.back().path); //scrolled past long ago
+        queue.pop_back();
+    }
+    work_ready.notify_one();
+    return false;
+}
+
+void ThumbnailCache::dropEntry(const std::string &path){
+    std::unordered_map<std::string, Entry>::iterator known = entries.find(path);
+    if(known == entries.end()){
+        return;
+    }
+    if(known->second.slot >= 0){
+        slots[known->second.slot].path.clear();
+        free_slots.push_back(known->second.slot);
+    }
+    entries.erase(known);
+}
+
+//a free cell of the atlas: an unused one, one on a new page while the budget
+//allows (the first page always), else the one drawn longest ago (never one
+//drawn this frame or the last, it is likely still on screen)
+int ThumbnailCache::takeSlot(SDL_Renderer *renderer){
+    if(free_slots.empty() && (pages.empty() || pool->fits(THUMB_PAGE_SIZE * THUMB_PAGE_SIZE * 4))){
+        TextureHandle page = pool->createTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC,
+                                                 THUMB_PAGE_SIZE, THUMB_PAGE_SIZE);
+        if(page){
+            SDL_SetTextureBlendMode(page.get(), SDL_BLENDMODE_BLEND);
+            pages.push_back(std::move(page));
+            int per_row = THUMB_PAGE_SIZE / THUMB_SIZE;
+            for(int i = per_row * per_row - 1; i >= 0; i--){
+                Slot slot;
+                slot.page = pages.size() - 1;
+                slot.cell.x = (i % per_row) * THUMB_SIZE;
+                slot.cell.y = (i / per_row) * THUMB_SIZE;
+                slot.cell.w = THUMB_SIZE;
+                slot.cell.h = THUMB_SIZE;
+                slot.used = 0;
+                free_slots.push_back(slots.size());
+                slots.push_back(slot);
+            }
+        }
+    }
+    if(!free_slots.empty()){
+        int slot = free_slots.back();
+        free_slots.pop_back();
+        return slot;
+    }
+    int oldest = -1;
+    for(int i = 0; i < slots.size(); i++){
+        if(slots[i].used + 1 < frame && (oldest < 0 || slots[i].used < slots[oldest].used)){
+            oldest = i;
+        }
+    }
+    if(oldest >= 0){
+        entries.erase(slots[oldest].path);
+    }
+    return oldest;
+}
+
+//puts a finished decode into the atlas, or parks it if every cell was
+//drawn this frame. takes the decode.
+void ThumbnailCache::place(SDL_Renderer *renderer, Decoded *decoded){
+    dropEntry(decoded->path);
+    Entry entry;
+    entry.mtime = decoded->mtime;
+    entry.slot = decoded->pixels.empty() ? -1 : takeSlot(renderer);
+    if(entry.slot < 0 && !decoded->pixels.empty()){
+        park(decoded);
+        return;
+    }
+    if(entry.slot >= 0){
+        Slot &slot = slots[entry.slot];
+        slot.cell.w = decoded->w;
+        slot.cell.h = decoded->h;
+        slot.used = frame;
+        slot.path = decoded->path;
+        SDL_UpdateTexture(pages[slot.page].get(), &slot.cell, decoded->pixels.data(), decoded->w * 4);
+        placed++;
+    }
+    entries[decoded->path] = entry;
+    delete decoded;
+}
+
+//holds on to pixels that found no cell, so draw() can use them once one
+//frees up instead of having them decoded again
+void ThumbnailCache::park(Decoded *decoded){
+    std::unordered_map<std::string, Parked>::iterator old = parked.find(decoded->path);
+    if(old != parked.end()){
+        delete old->second.decoded;
+        old->second.decoded = decoded;
+        return;
+    }
+    if(parked.size() >= THUMB_PARKED_MAX){
+        delete parked.begin()->second.decoded; //requested before the rest filled up, any of them will do
+        parked.erase(parked.begin());
+    }
+    Parked waiting;
+    waiting.decoded = decoded;
+    waiting.used = frame;
+    parked[decoded->path] = waiting;
+}
+
+int ThumbnailCache::upload(SDL_Renderer *renderer){
+    std::vector<Decoded *> batch;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        frame++;
+        size_t count = std::min(ready.size(), (size_t)THUMB_UPLOADS_PER_FRAME);
+        batch.assign(ready.begin(), ready.begin() + count);
+        ready.erase(ready.begin(), ready.begin() + count);
+        for(int i = 0; i < batch.size(); i++){
+            wanted.erase(batch[i]->path);
+        }
+    }
+    placed = 0;
+    for(std::unordered_map<std::string, Parked>::iterator it = parked.begin(); it != parked.end();){
+        if(it->second.used + 1 < frame){
+            delete it->second.decoded; //scrolled away while waiting
+            it = parked.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for(int i = 0; i < batch.size(); i++){
+        place(renderer, batch[i]);
+    }
+    return batch.size();
+}
+
+bool ThumbnailCache::busy(){
+    std::lock_guard<std::mutex> guard(lock);
+    return !queue.empty() || decoding > 0 || !ready.empty();
+}
+
+void ThumbnailCache::run(){
+    while(true){
+        Request request;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            work_ready.wait(guard, [this](){ return quitting || !queue.empty(); });
+            if(quitting){
+                return;
+            }
+            request = queue.front();
+            queue.pop_front();
+            std::unordered_map<std::string, unsigned>::iterator pending = wanted.find(request.path);
+            if(pending == wanted.end() || frame - pending->second > THUMB_STALE_FRAMES){
+                if(pending != wanted.end()){
+                    wanted.erase(pending); //off screen for a while, asked for again if it comes back
+                }
+                continue;
+            }
+            decoding++;
+        }
+
+        Decoded *decoded = new Decoded();
+        decode(request, decoded);
+
+        bool first;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            decoding--;
+            first = ready.empty();
+            ready.push_back(decoded);
+        }
+        if(first){
+            wake();
+        }
+    }
+}
+
+//the freedesktop thumbnail if it is current, else the image itself (which
+//then leaves a freedesktop thumbnail behind). either way shrunk to
+//THUMB_SIZE right here, only the small copy goes to the main thread.
+void ThumbnailCache::decode(const Request &request, Decoded *decoded){
+    decoded->path = request.path;
+    decoded->mtime = request.mtime;
+    decoded->w = 0;
+    decoded->h = 0;
+
+    std::string uri = thumbnailUri(request.path);
+    std::string cached = thumbnailFile(uri);
+    bool from_cache = thumbnailMTime(cached) == request.mtime;
+    SDL_Surface *loaded = IMG_Load(from_cache ? cached.c_str() : request.path.c_str());
+    if(loaded == NULL && from_cache){
+        from_cache = false;
+        loaded = IMG_Load(request.path.c_str());
+    }
+    if(loaded == NULL){
+        return;
+    }
+    SDL_Surface *image = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_ARGB8888, 0);
+    SDL_FreeSurface(loaded);
+    if(image == NULL){
+        return;
+    }
+
+    const uint32_t *source = (const uint32_t *)image->pixels;
+    int source_w = image->w;
+    int source_h = image->h;
+    int pitch = image->pitch / 4;
+    std::vector<uint32_t> normal;
+    std::string thumbnail_root = cached.substr(0, cached.rfind("/normal/") + 1);
+    bool is_thumbnail = request.path.compare(0, thumbnail_root.size(), thumbnail_root) == 0; //no thumbnails of thumbnails
+    if(!from_cache && persist && !is_thumbnail && (source_w > THUMB_NORMAL_SIZE || source_h > THUMB_NORMAL_SIZE)){
+        int w, h;
+        fitSize(source_w, source_h, THUMB_NORMAL_SIZE, &w, &h);
+        normal.resize(w * h);
+        shrinkPixels(source, source_w, source_h, pitch, normal.data(), w, h);
+        writeThumbnail(cached, normal.data(), w, h, uri, request.mtime);
+        source = normal.data(); //smaller start for the next step
+        source_w = w;
+        source_h = h;
+        pitch = w;
+    }
+
+    fitSize(source_w, source_h, THUMB_SIZE, &decoded->w, &decoded->h);
+    decoded->pixels.resize(decoded->w * decoded->h);
+    shrinkPixels(source, source_w, source_h, pitch, decoded->pixels.data(), decoded->w, decoded->h);
+    SDL_FreeSurface(image);
+}
@@ -0,0 +1,122 @@
+#ifdef USE_TRACE
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include "trace.h"
+
+struct TraceEvent {
+    const char *name;
+    int thread;
+    int64_t start; //microseconds since the first scope
+    int64_t length;
+};
+
+struct FrameCounts {
+    int64_t at;
+    uint64_t counters[TRACE_COUNTERS];
+};
+
+static std::mutex trace_lock; //everything down to frame_counts
+static std::vector<TraceEvent> events;
+static size_t dropped = 0;
+static TraceFrame open_frame; //sums of the frame in progress
+static std::vector<FrameCounts> frame_counts;
+static std::atomic<uint64_t> counters[TRACE_COUNTERS];
+static std::atomic<int> next_thread(0);
+static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+static int64_t now(){
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+static int threadId(){
+    static thread_local int id = next_thread++;
+    return id;
+}
+
+TraceScope::TraceScope(const char *name) : name(name), start(now())
+{
+}
+
+TraceScope::~TraceScope(){
+    int64_t length = now() - start;
+    int thread = threadId();
+    std::lock_guard<std::mutex> guard(trace_lock);
+    if(events.size() < TRACE_MAX_EVENTS){
+        TraceEvent event = { name, thread, start, length };
+        events.push_back(event);
+    } else {
+        dropped++;
+    }
+    //names are string literals, the same scope always has the same pointer
+    int slot = 0;
+    while(slot < open_frame.scopes && open_frame.scope_names[slot] != name){
+        slot++;
+    }
+    if(slot == open_frame.scopes){
+        if(slot == TRACE_FRAME_SCOPES){
+            return;
+        }
+        open_frame.scopes++;
+        open_frame.scope_names[slot] = name;
+        open_frame.scope_ms[slot] = 0;
+        open_frame.worst_ms[slot] = 0;
+    }
+    double ms = length / 1000.0;
+    open_frame.scope_ms[slot] += ms;
+    if(ms > open_frame.worst_ms[slot]){
+        open_frame.worst_ms[slot] = ms;
+    }
+}
+
+void traceCount(TraceCounter counter, uint64_t n){
+    counters[counter].fetch_add(n, std::memory_order_relaxed);
+}
+
+void traceFrame(TraceFrame *frame){
+    FrameCounts counts;
+    counts.at = now();
+    for(int c = 0; c < TRACE_COUNTERS; c++){
+        counts.counters[c] = counters[c].exchange(0, std::memory_order_relaxed);
+    }
+    std::lock_guard<std::mutex> guard(trace_lock);
+    *frame = open_frame;
+    memcpy(frame->counters, counts.counters, sizeof(counts.counters));
+    open_frame.scopes = 0;
+    if(frame_counts.size() < TRACE_MAX_EVENTS){
+        frame_counts.push_back(counts);
+    }
+}
+
+//names are literals from the source, nothing in them needs escaping
+bool traceWrite(const std::string &file){
+    FILE *out = fopen(file.c_str(), "w");
+    if(out == NULL){
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(trace_lock);
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for(size_t i = 0; i < events.size(); i++){
+        const TraceEvent &event = events[i];
+        fprintf(out, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld},\n",
+                event.name, event.thread, (long long)event.start, (long long)event.length);
+    }
+    static const char *counter_names[TRACE_COUNTERS] = { "syscalls", "textures", "draw calls" };
+    for(size_t i = 0; i < frame_counts.size(); i++){
+        fprintf(out, "{\"name\":\"per frame\",\"ph\":\"C\",\"pid\":1,\"ts\":%lld,\"args\":{", (long long)frame_counts[i].at);
+        for(int c = 0; c < TRACE_COUNTERS; c++){
+            fprintf(out, "%s\"%s\":%llu", c ? "," : "", counter_names[c], (unsigned long long)frame_counts[i].counters[c]);
+        }
+        fprintf(out, "}},\n");
+    }
+    fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"fileexplorer (%zu scopes dropped)\"}}\n]}\n",
+            dropped);
+    bool ok = !ferror(out);
+    return fclose(out) == 0 && ok;
+}
+
+#endif
@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <string.h>
+#include "treewalker.h"
+
+TreeWalker::TreeWalker(std::function<void()> wake_fn, unsigned thread_count)
+    : wake(wake_fn), generation(0), next_node(1), queued(0), quitting(false),
+      backlog(0), folders(0), folders_left(0), entries(0)
+{
+    if(thread_count == 0){
+        thread_count = std::max(2u, std::thread::hardware_concurrency());
+    }
+    for(unsigned t = 0; t < thread_count; t++){
+        queues.push_back(new TaskQueue);
+    }
+    for(unsigned t = 0; t < thread_count; t++){
+        threads.push_back(std::thread(&TreeWalker::run, this, t));
+    }
+}
+
+TreeWalker::~TreeWalker(){
+    {
+        std::lock_guard<std::mutex> guard(idle_lock);
+        quitting = true;
+        generation++;
+    }
+    idle_wakeup.notify_all();
+    {
+        std::lock_guard<std::mutex> guard(done_lock); //a thread waiting for room sees the new generation
+    }
+    drained.notify_all();
+    for(int t = 0; t < threads.size(); t++){
+        threads[t].join();
+    }
+    for(int t = 0; t < queues.size(); t++){
+        delete queues[t];
+    }
+    for(int i = 0; i < finished.size(); i++){
+        delete finished[i].node;
+    }
+}
+
+unsigned TreeWalker::start(const std::string &path, int max_depth, const SortOrder &order){
+    unsigned gen;
+    {
+        std::lock_guard<std::mutex> guard(done_lock);
+        gen = ++generation; //running tasks see this and throw their work away
+        folders = 0;
+        folders_left = 1;
+        entries = 0;
+    }
+    drained.notify_all();
+    for(int t = 0; t < queues.size(); t++){
+        std::lock_guard<std::mutex> guard(queues[t]->lock);
+        queued -= queues[t]->tasks.size();
+        queues[t]->tasks.clear();
+    }
+    next_node = 1;
+
+    Task root;
+    root.path = path;
+    root.node = 0;
+    root.parent = -1;
+    root.depth = 0;
+    root.max_depth = max_depth;
+    root.order = order;
+    root.generation = gen;
+    push(0, root);
+    return gen;
+}
+
+void TreeWalker::cancel(){
+    {
+        std::lock_guard<std::mutex> guard(done_lock);
+        generation++;
+        folders_left = 0;
+    }
+    drained.notify_all();
+    for(int t = 0; t < queues.size(); t++){
+        std::lock_guard<std::mutex> guard(queues[t]->lock);
+        queued -= queues[t]->tasks.size();
+        queues[t]->tasks.clear();
+    }
+    next_node = 1; //the next tree is numbered from its root again
+}
+
+unsigned TreeWalker::open(const std::string &path, int parent, int depth, const SortOrder &order, int *node){
+    Task task;
+    task.path = path;
+    task.node = next_node++;
+    task.parent = parent;
+    task.depth = depth;
+    task.max_depth = depth; //its subfolders are listed, not opened
+    task.order = order;
+    {
+        std::lock_guard<std::mutex> guard(done_lock);
+        task.generation = generation.load();
+        folders_left++;
+    }
+    push(0, task);
+    *node = task.node;
+    return task.generation;
+}
+
+bool TreeWalker::poll(std::vector<Result> *results){
+    {
+        std::lock_guard<std::mutex> guard(done_lock);
+        results->clear();
+        results->swap(finished);
+    }
+    drained.notify_all();
+    return !results->empty();
+}
+
+void TreeWalker::setBacklog(size_t nodes){
+    {
+        std::lock_guard<std::mutex> guard(done_lock);
+        backlog = nodes;
+    }
+    drained.notify_all();
+}
+
+TreeProgress TreeWalker::progress(){
+    std::lock_guard<std::mutex> guard(done_lock);
+    TreeProgress p;
+    p.folders = folders;
+    p.folders_left = folders_left;
+    p.entries = entries;
+    p.done = (folders_left == 0);
+    return p;
+}
+
+void TreeWalker::push(unsigned self, const Task &task){
+    {
+        std::lock_guard<std::mutex> guard(queues[self]->lock);
+        queues[self]->tasks.push_back(task);
+    }
+    {
+        //taken so a thread between its empty check and its wait cannot miss this
+        std::lock_guard<std::mutex> guard(idle_lock);
+        queued++;
+    }
+    idle_wakeup.notify_one();
+}
+
+//newest task of our own queue (depth first, warm caches), else the oldest
+//one of somebody else's, which tends to be the biggest subtree left
+bool TreeWalker::take(unsigned self, Task *task){
+    for(unsigned i = 0; i < queues.size(); i++){
+        TaskQueue *queue = queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(queue->lock);
+        if(queue->tasks.empty()){
+            continue;
+        }
+        if(i == 0){
+            *task = queue->tasks.back();
+            queue->tasks.pop_back();
+        } else {
+            *task = queue->tasks.front();
+            queue->tasks.pop_front();
+        }
+        queued--;
+        return true;
+    }
+    return false;
+}
+
+void TreeWalker::run(unsigned self){
+    while(true){
+        Task task;
+        if(take(self, &task)){
+            if(task.generation == generation.load()){
+                expand(self, task);
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(idle_lock);
+        idle_wakeup.wait(guard, [this]{ return quitting || queued.load() > 0; });
+        if(quitting){
+            return;
+        }
+    }
+}
+
+//reads one folder, gives each subfolder a node index and queues it, or
+//reads it right away when the queues are full
+void TreeWalker::expand(unsigned self, const Task &task){
+    TreeNode *node = new TreeNode;
+    node->path = task.path;
+    node->parent = task.parent;
+    node->depth = task.depth;
+    node->loaded = true;
+    node->expanded = true;
+    updateFileList(&node->entries, task.path, task.depth > 0, task.order);
+
+    std::vector<Task> children;
+    const EntryStore &list = node->entries;
+    bool current = task.generation == generation.load(); //a cancelled one takes no numbers from the next tree
+    for(size_t i = 0; i < list.size() && task.depth < task.max_depth && current; i++){
+        //links are listed but never followed, a link back up would never end
+        if(list.type(i) != TYPE_DIRECTORY || list.isLink(i) || strcmp(list.name(i), "..") == 0){
+            continue;
+        }
+        Task child;
+        child.path = task.path == "/" ? "/" + std::string(list.name(i)) : task.path + "/" + list.name(i);
+        child.node = next_node++;
+        child.parent = task.node;
+        child.depth = task.depth + 1;
+        child.max_depth = task.max_depth;
+        child.order = task.order;
+        child.generation = task.generation;
+        node->entries.setChild(i, child.node);
+        children.push_back(child);
+    }
+
+    bool first;
+    {
+        std::unique_lock<std::mutex> guard(done_lock);
+        drained.wait(guard, [&]{
+            return backlog == 0 || finished.size() < backlog || task.generation != generation.load();
+        });
+        if(task.generation != generation.load()){
+            delete node; //cancelled while we were reading
+            return;
+        }
+        folders++;
+        folders_left += children.size();
+        folders_left--;
+        entries += list.size();
+        first = finished.empty();
+        Result result;
+        result.index = task.node;
+        result.generation = task.generation;
+        result.node = node;
+        finished.push_back(result);
+    }
+    //one wake per drained queue, the main thread takes everything at once
+    if(first){
+        wake();
+    }
+
+    for(int i = 0; i < children.size() && task.generation == generation.load(); i++){
+        if(queued.load() < TREE_QUEUED_MAX){
+            push(self, children[i]);
+        } else {
+            expand(self, children[i]); //queues are full, go down right here
+        }
+    }
+}